@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -79,6 +80,130 @@ static int arduino_read_sig_bytes(const PROGRAMMER *pgm, const AVRPART *p, const
   return 3;
 }
 
+/*
+ * Baud rates tried by -x autobaud after the cached and the requested
+ * one, fastest first
+ */
+static const long arduino_baud_ladder[] = {
+  1000000, 500000, 250000, 230400, 115200, 57600, 38400, 19200,
+};
+
+#define ARDUINO_SYNC_POLL_MS 20        // Resend STK_GET_SYNC after this long
+#define ARDUINO_SYNC_DEADLINE_MS 1000  // Optiboot starts the sketch after 1 s
+
+static void arduino_reset(const PROGRAMMER *pgm) {
+  /* Clear DTR and RTS to unload the RESET capacitor 
+   * (for example in Arduino) */
+  serial_set_dtr_rts(&pgm->fd, 0);
+  usleep(250*1000);
+  /* Set DTR and RTS back to high */
+  serial_set_dtr_rts(&pgm->fd, 1);
+}
+
+/*
+ * Send STK_GET_SYNC every ARDUINO_SYNC_POLL_MS right after a reset
+ * until the bootloader answers STK_INSYNC, STK_OK or deadline_ms have
+ * passed, so the wait tracks the actual start-up time of the
+ * bootloader; input left over from the sketch is skipped on the way
+ */
+static int arduino_sync(const PROGRAMMER *pgm, long deadline_ms) {
+  const long saved_timeout = serial_recv_timeout;
+  unsigned char buf[2], c, prev;
+  struct timeval start, now;
+  long elapsed = 0;
+  int rc = -1;
+
+  serial_recv_timeout = ARDUINO_SYNC_POLL_MS;
+  gettimeofday(&start, NULL);
+  do {
+    buf[0] = Cmnd_STK_GET_SYNC;
+    buf[1] = Sync_CRC_EOP;
+    serial_send(&pgm->fd, buf, 2);
+
+    prev = 0;
+    while (elapsed < deadline_ms && serial_recv(&pgm->fd, &c, 1) >= 0) {
+      if (prev == Resp_STK_INSYNC && c == Resp_STK_OK) {
+        rc = 0;
+        break;
+      }
+      prev = c;
+      gettimeofday(&now, NULL);
+      elapsed = (now.tv_sec - start.tv_sec)*1000 + (now.tv_usec - start.tv_usec)/1000;
+    }
+
+    gettimeofday(&now, NULL);
+    elapsed = (now.tv_sec - start.tv_sec)*1000 + (now.tv_usec - start.tv_usec)/1000;
+  } while (rc < 0 && elapsed < deadline_ms);
+
+  if (rc == 0) {
+    /* Answers to earlier requests may still be on their way */
+    while (serial_recv(&pgm->fd, &c, 1) >= 0)
+      continue;
+    avrdude_message(MSG_NOTICE, "%s: bootloader in sync %ld ms after reset\n",
+                    progname, elapsed);
+  }
+
+  serial_recv_timeout = saved_timeout;
+
+  return rc;
+}
+
+/*
+ * Reset the board and see whether the bootloader answers STK_GET_SYNC
+ * at the given baud rate; unlike stk500_getsync(), fail fast and
+ * quietly
+ */
+static int arduino_probe_baud(const PROGRAMMER *pgm, long baud) {
+  if (serial_setparams(&pgm->fd, baud, SERIAL_8N1) < 0)
+    return -1;
+
+  arduino_reset(pgm);
+
+  return arduino_sync(pgm, ARDUINO_SYNC_DEADLINE_MS/2);
+}
+
+/*
+ * Find the baud rate the bootloader runs at: try the rate cached for
+ * this port by a previous run, then the requested one, then step down
+ * from the fastest rate in arduino_baud_ladder
+ */
+static int arduino_autobaud(PROGRAMMER *pgm) {
+  long tried[2 + sizeof(arduino_baud_ladder)/sizeof(*arduino_baud_ladder)];
+  int ntried = 0, i, j, rc = -1;
+
+  tried[ntried++] = serial_baud_cache_get(pgm->port);
+  tried[ntried++] = pgm->baudrate? pgm->baudrate: 115200;
+  for (i = 0; i < (int) (sizeof(arduino_baud_ladder)/sizeof(*arduino_baud_ladder)); i++)
+    tried[ntried++] = arduino_baud_ladder[i];
+
+  for (i = 0; i < ntried; i++) {
+    if (tried[i] <= 0)
+      continue;
+    for (j = 0; j < i; j++)     // Skip duplicates
+      if (tried[j] == tried[i])
+        break;
+    if (j < i)
+      continue;
+
+    avrdude_message(MSG_NOTICE2, "%s: arduino_autobaud(): trying %ld baud\n",
+                    progname, tried[i]);
+    if (arduino_probe_baud(pgm, tried[i]) == 0) {
+      avrdude_message(MSG_INFO, "%s: bootloader found at %ld baud\n",
+                      progname, tried[i]);
+      pgm->baudrate = tried[i];
+      serial_baud_cache_put(pgm->port, tried[i]);
+      rc = 0;
+      break;
+    }
+  }
+
+  if (rc < 0)
+    avrdude_message(MSG_INFO, "%s: arduino_autobaud(): no response from "
+                    "bootloader at any baud rate\n", progname);
+
+  return rc;
+}
+
 static int arduino_open(PROGRAMMER *pgm, const char *port) {
   union pinfo pinfo;
   strcpy(pgm->port, port);
@@ -88,19 +213,16 @@ static int arduino_open(PROGRAMMER *pgm, const char *port) {
     return -1;
   }
 
-  /* Clear DTR and RTS to unload the RESET capacitor 
-   * (for example in Arduino) */
-  serial_set_dtr_rts(&pgm->fd, 0);
-  usleep(250*1000);
-  /* Set DTR and RTS back to high */
-  serial_set_dtr_rts(&pgm->fd, 1);
-  usleep(50*1000);
+  if (PDATA(pgm)->autobaud)
+    return arduino_autobaud(pgm);
 
-  /*
-   * drain any extraneous input
-   */
-  stk500_drain(pgm, 0);
+  arduino_reset(pgm);
 
+  if (arduino_sync(pgm, ARDUINO_SYNC_DEADLINE_MS) == 0)
+    return 0;
+
+  /* Fall back to the slower, but more patient, STK500 sync */
+  stk500_drain(pgm, 0);
   if (stk500_getsync(pgm) < 0)
     return -1;
 
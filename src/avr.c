@@ -34,9 +34,17 @@
 #include "tpi.h"
 
 FP_UpdateProgress update_progress;
+FP_ProgressEvent progress_event;
+int progress_event_hz = 10;
+
+static const char *progress_memory;
+static int progress_retries;
 
 #define DEBUG 0
 
+/* Max bytes read or words written per avr_tpi_cmd_block() call */
+#define TPI_BLOCK_MAX 256
+
 /* TPI: returns 1 if NVM controller busy, 0 if free */
 int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm) {
   unsigned char cmd;
@@ -47,6 +55,35 @@ int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm) {
   return (res & TPI_IOREG_NVMCSR_NVMBSY);
 }
 
+/*
+ * TPI: execute a stream of TPI instructions (see tpi_insn_len()),
+ * collecting the response bytes in res[]; uses the programmer's
+ * cmd_tpi_block() if it has one, otherwise one cmd_tpi() call per
+ * instruction
+ */
+int avr_tpi_cmd_block(const PROGRAMMER *pgm, const unsigned char *cmd, int cmd_len,
+                      unsigned char *res, int res_len) {
+  int i, n, nres, rx;
+
+  if (pgm->cmd_tpi_block)
+    return pgm->cmd_tpi_block(pgm, cmd, cmd_len, res, res_len);
+
+  for (i = rx = 0; i < cmd_len; i += n) {
+    n = tpi_insn_len(cmd[i], &nres);
+    if (i + n > cmd_len || rx + nres > res_len)
+      return -1;
+    if (cmd[i] == TPI_BLOCK_DELAY) {
+      usleep(cmd[i+1] * TPI_BLOCK_DELAY_UNIT);
+      continue;
+    }
+    if (pgm->cmd_tpi(pgm, cmd + i, n, res + rx, nres) == -1)
+      return -1;
+    rx += nres;
+  }
+
+  return 0;
+}
+
 /* TPI chip erase sequence */
 int avr_tpi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
 	int err;
@@ -145,34 +182,36 @@ int avr_tpi_program_enable(const PROGRAMMER *pgm, const AVRPART *p, unsigned cha
 	}
 }
 
-/* TPI: setup NVMCMD register and pointer register (PR) for read/write/erase */
-static int avr_tpi_setup_rw(const PROGRAMMER *pgm, const AVRMEM *mem,
+/*
+ * TPI: put instructions into cmd[] that set the NVMCMD register and the
+ * pointer register (PR) for read/write/erase; returns their length
+ */
+static int avr_tpi_setup_rw_insns(unsigned char *cmd, const AVRMEM *mem,
 			    unsigned long addr, unsigned char nvmcmd)
 {
-  unsigned char cmd[4];
-  int rc;
-
   /* set NVMCMD register */
   cmd[0] = TPI_CMD_SOUT | TPI_SIO_ADDR(TPI_IOREG_NVMCMD);
   cmd[1] = nvmcmd;
-  rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0);
-  if (rc == -1)
-    return -1;
 
   /* set Pointer Register (PR) */
-  cmd[0] = TPI_CMD_SSTPR | 0;
-  cmd[1] = (mem->offset + addr) & 0xFF;
-  rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0);
-  if (rc == -1)
-    return -1;
+  cmd[2] = TPI_CMD_SSTPR | 0;
+  cmd[3] = (mem->offset + addr) & 0xFF;
 
-  cmd[0] = TPI_CMD_SSTPR | 1;
-  cmd[1] = ((mem->offset + addr) >> 8) & 0xFF;
-  rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0);
-  if (rc == -1)
-    return -1;
+  cmd[4] = TPI_CMD_SSTPR | 1;
+  cmd[5] = ((mem->offset + addr) >> 8) & 0xFF;
 
-  return 0;
+  return 6;
+}
+
+/* TPI: setup NVMCMD register and pointer register (PR) for read/write/erase */
+static int avr_tpi_setup_rw(const PROGRAMMER *pgm, const AVRMEM *mem,
+			    unsigned long addr, unsigned char nvmcmd)
+{
+  unsigned char cmd[6];
+  int len;
+
+  len = avr_tpi_setup_rw_insns(cmd, mem, addr, nvmcmd);
+  return avr_tpi_cmd_block(pgm, cmd, len, NULL, 0);
 }
 
 int avr_read_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
@@ -330,6 +369,33 @@ int avr_read(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, const
 }
 
 
+/*
+ * Return whether the page of m starting at pageaddr contains any byte
+ * tagged TAG_ALLOCATED, ie, any byte that came from an input file
+ */
+static int avr_page_allocated(const AVRMEM *m, unsigned int pageaddr) {
+  unsigned int i;
+
+  for (i = pageaddr; i < pageaddr + m->page_size; i++)
+    if (m->tags[i] & TAG_ALLOCATED)
+      return 1;
+
+  return 0;
+}
+
+/*
+ * Number of bytes to request from one paged_load()/paged_write() call
+ * for memory m: the programmer's max_paged_xfer rounded down to whole
+ * pages, but at least one page
+ */
+static unsigned int avr_paged_xfer(const PROGRAMMER *pgm, const AVRMEM *m) {
+  if (pgm->max_paged_xfer <= m->page_size)
+    return m->page_size;
+
+  return pgm->max_paged_xfer / m->page_size * m->page_size;
+}
+
+
 /*
  * Read the entirety of the specified memory into the corresponding buffer of
  * the avrpart pointed to by p. If v is non-NULL, verify against v's memory
@@ -339,7 +405,6 @@ int avr_read(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, const
  */
 int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRPART *v) {
   unsigned long i, lastaddr;
-  unsigned char cmd[4];
   AVRMEM *vmem = NULL;
   int rc;
 
@@ -359,24 +424,32 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
     /* setup for read (NOOP) */
     avr_tpi_setup_rw(pgm, mem, 0, TPI_NVMCMD_NO_OPERATION);
 
-    /* load bytes */
-    for (lastaddr = i = 0; i < mem->size; i++) {
-      if (vmem == NULL ||
-          (vmem->tags[i] & TAG_ALLOCATED) != 0)
-      {
-        if (lastaddr != i) {
-          /* need to setup new address */
-          avr_tpi_setup_rw(pgm, mem, i, TPI_NVMCMD_NO_OPERATION);
-          lastaddr = i;
-        }
-        cmd[0] = TPI_CMD_SLD_PI;
-        rc = pgm->cmd_tpi(pgm, cmd, 1, mem->buf + i, 1);
-        lastaddr++;
-        if (rc == -1) {
-          avrdude_message(MSG_INFO, "avr_read_mem(): error reading address 0x%04lx\n", i);
-          return -1;
-        }
+    /* load runs of needed bytes, up to TPI_BLOCK_MAX at a time */
+    for (lastaddr = i = 0; i < mem->size; ) {
+      unsigned char block[6 + TPI_BLOCK_MAX];
+      unsigned long n;
+      int len = 0;
+
+      for (n = 0; i + n < mem->size && n < TPI_BLOCK_MAX; n++)
+        if (vmem != NULL && (vmem->tags[i + n] & TAG_ALLOCATED) == 0)
+          break;
+      if (n == 0) {
+        report_progress(i++, mem->size, NULL);
+        continue;
       }
+
+      if (lastaddr != i) {
+        /* need to setup new address */
+        len = avr_tpi_setup_rw_insns(block, mem, i, TPI_NVMCMD_NO_OPERATION);
+      }
+      memset(block + len, TPI_CMD_SLD_PI, n);
+      rc = avr_tpi_cmd_block(pgm, block, len + n, mem->buf + i, n);
+      if (rc == -1) {
+        avrdude_message(MSG_INFO, "avr_read_mem(): error reading address 0x%04lx\n", i);
+        return -1;
+      }
+      i += n;
+      lastaddr = i;
       report_progress(i, mem->size, NULL);
     }
     return avr_mem_hiaddr(mem);
@@ -388,7 +461,7 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
      * the programmer supports a paged mode read
      */
     int need_read, failure;
-    unsigned int pageaddr;
+    unsigned int pageaddr, nbytes, xfer;
     unsigned int npages, nread;
 
     /* quickly scan number of pages to be written to first */
@@ -409,33 +482,35 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
         }
     }
 
+    /* read runs of consecutive needed pages, up to xfer bytes at a time */
+    xfer = avr_paged_xfer(pgm, mem);
     for (pageaddr = 0, failure = 0, nread = 0;
          !failure && pageaddr < mem->size;
-         pageaddr += mem->page_size) {
+         pageaddr += nbytes) {
+      nbytes = mem->page_size;
       /* check whether this page must be read */
-      for (i = pageaddr, need_read = 0;
-           i < pageaddr + mem->page_size;
-           i++)
-        if (vmem == NULL /* no verify, read everything */ ||
-            (vmem->tags[i] & TAG_ALLOCATED) != 0 /* verify, do only
-                                                    read pages that
-                                                    are needed in
-                                                    input file */) {
-          need_read = 1;
-          break;
-        }
+      need_read = vmem == NULL /* no verify, read everything */ ||
+        avr_page_allocated(vmem, pageaddr) /* verify, do only read pages
+                                              that are needed in input file */;
       if (need_read) {
+        while (nbytes + mem->page_size <= xfer &&
+               pageaddr + nbytes < (unsigned int) mem->size &&
+               (vmem == NULL || avr_page_allocated(vmem, pageaddr + nbytes)))
+          nbytes += mem->page_size;
+        trace_begin("paged_load");
         rc = pgm->paged_load(pgm, p, mem, mem->page_size,
-                            pageaddr, mem->page_size);
+                            pageaddr, nbytes);
+        trace_end();
         if (rc < 0)
           /* paged load failed, fall back to byte-at-a-time read below */
           failure = 1;
+        nread += nbytes / mem->page_size;
+        trace_counter("bytes read", (long) nread * mem->page_size);
       } else {
         avrdude_message(MSG_DEBUG, "%s: avr_read_mem(): skipping page %u: no interesting data\n",
                         progname, pageaddr / mem->page_size);
       }
-      nread++;
-      report_progress(nread, npages, NULL);
+      report_progress(nread * mem->page_size, npages * mem->page_size, NULL);
     }
     if (!failure)
       return avr_mem_hiaddr(mem);
@@ -785,6 +860,8 @@ int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
       
       return -6;
     }
+    if (!ready)
+      report_progress_retry();
   }
 
   pgm->pgm_led(pgm, OFF);
@@ -836,7 +913,7 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
   unsigned int     i, lastaddr;
   unsigned char    data;
   int              werror;
-  unsigned char    cmd[4];
+  int              nwords, delay;
 
   pgm->err_led(pgm, OFF);
 
@@ -871,28 +948,58 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
       wsize++;
     }
 
+    /*
+     * With a word write time from the part description, queue runs of
+     * words separated by that fixed delay and only poll NVMBSY at the
+     * end of each run; otherwise poll after every word.
+     */
+    nwords = TPI_BLOCK_MAX/2;
+    delay = 0;
+    if (m->max_write_delay > 0) {
+      delay = (m->max_write_delay + TPI_BLOCK_DELAY_UNIT - 1) / TPI_BLOCK_DELAY_UNIT;
+      if (delay > 255)
+        delay = 255;
+    } else
+      nwords = 1;
+
     /* write words, low byte first */
-    for (lastaddr = i = 0; i < wsize; i += 2) {
-      if ((m->tags[i] & TAG_ALLOCATED) != 0 ||
-          (m->tags[i + 1] & TAG_ALLOCATED) != 0) {
-
-        if (lastaddr != i) {
-          /* need to setup new address */
-          avr_tpi_setup_rw(pgm, m, i, TPI_NVMCMD_WORD_WRITE);
-          lastaddr = i;
-        }
+    for (lastaddr = i = 0; i < wsize; ) {
+      unsigned char block[6 + 6*TPI_BLOCK_MAX/2];
+      int n, len = 0;
 
-        cmd[0] = TPI_CMD_SST_PI;
-        cmd[1] = m->buf[i];
-        rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0);
+      for (n = 0; i + 2*n < (unsigned int) wsize && n < nwords; n++)
+        if ((m->tags[i + 2*n] & TAG_ALLOCATED) == 0 &&
+            (m->tags[i + 2*n + 1] & TAG_ALLOCATED) == 0)
+          break;
+      if (n == 0) {
+        i += 2;
+        report_progress(i, wsize, NULL);
+        continue;
+      }
 
-        cmd[1] = m->buf[i + 1];
-        rc = pgm->cmd_tpi(pgm, cmd, 2, NULL, 0);
+      if (lastaddr != i) {
+        /* need to setup new address */
+        len = avr_tpi_setup_rw_insns(block, m, i, TPI_NVMCMD_WORD_WRITE);
+      }
+      for (lastaddr = i; n > 0; n--, lastaddr += 2) {
+        block[len++] = TPI_CMD_SST_PI;
+        block[len++] = m->buf[lastaddr];
+        block[len++] = TPI_CMD_SST_PI;
+        block[len++] = m->buf[lastaddr + 1];
+        if (delay && n > 1) {
+          block[len++] = TPI_BLOCK_DELAY;
+          block[len++] = delay;
+        }
+      }
+      rc = avr_tpi_cmd_block(pgm, block, len, NULL, 0);
+      if (rc == -1) {
+        avrdude_message(MSG_INFO, "avr_write_mem(): error writing address 0x%04x\n", i);
+        return LIBAVRDUDE_GENERAL_FAILURE;
+      }
+      i = lastaddr;
 
-        lastaddr += 2;
+      while (avr_tpi_poll_nvmbsy(pgm));
 
-        while (avr_tpi_poll_nvmbsy(pgm));
-      }
       report_progress(i, wsize, NULL);
     }
     return i;
@@ -903,7 +1010,7 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
      * the programmer supports a paged mode write
      */
     int need_write, failure;
-    unsigned int pageaddr;
+    unsigned int pageaddr, nbytes, xfer;
     unsigned int npages, nwritten;
 
     /* quickly scan number of pages to be written to first */
@@ -920,32 +1027,38 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
         }
     }
 
+    /* write runs of consecutive tagged pages, up to xfer bytes at a time */
+    xfer = avr_paged_xfer(pgm, m);
     for (pageaddr = 0, failure = 0, nwritten = 0;
          !failure && pageaddr < wsize;
-         pageaddr += m->page_size) {
+         pageaddr += nbytes) {
+      nbytes = m->page_size;
       /* check whether this page must be written to */
-      for (i = pageaddr, need_write = 0;
-           i < pageaddr + m->page_size;
-           i++)
-        if ((m->tags[i] & TAG_ALLOCATED) != 0) {
-          need_write = 1;
-          break;
-        }
+      need_write = avr_page_allocated(m, pageaddr);
       if (need_write) {
+        while (nbytes + m->page_size <= xfer &&
+               pageaddr + nbytes < (unsigned int) wsize &&
+               avr_page_allocated(m, pageaddr + nbytes))
+          nbytes += m->page_size;
         rc = 0;
         if (auto_erase)
-          rc = pgm->page_erase(pgm, p, m, pageaddr);
-        if (rc >= 0)
-          rc = pgm->paged_write(pgm, p, m, m->page_size, pageaddr, m->page_size);
+          for (i = pageaddr; rc >= 0 && i < pageaddr + nbytes; i += m->page_size)
+            rc = pgm->page_erase(pgm, p, m, i);
+        if (rc >= 0) {
+          trace_begin("paged_write");
+          rc = pgm->paged_write(pgm, p, m, m->page_size, pageaddr, nbytes);
+          trace_end();
+        }
         if (rc < 0)
           /* paged write failed, fall back to byte-at-a-time write below */
           failure = 1;
+        nwritten += nbytes / m->page_size;
+        trace_counter("bytes written", (long) nwritten * m->page_size);
       } else {
         avrdude_message(MSG_DEBUG, "%s: avr_write_mem(): skipping page %u: no interesting data\n",
                         progname, pageaddr / m->page_size);
       }
-      nwritten++;
-      report_progress(nwritten, npages, NULL);
+      report_progress(nwritten * m->page_size, npages * m->page_size, NULL);
     }
     if (!failure)
       return wsize;
@@ -1163,6 +1276,105 @@ int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int s
 }
 
 
+/* CRCSCAN peripheral of UPDI parts */
+#define CRCSCAN_CTRLA           0x0120
+#define CRCSCAN_CTRLB           0x0121
+#define CRCSCAN_STATUS          0x0122
+#define CRCSCAN_CTRLA_ENABLE    0x01
+#define CRCSCAN_CTRLA_RESET     0x80
+#define CRCSCAN_CTRLB_SRC_FLASH 0x00
+#define CRCSCAN_STATUS_BUSY     0x01
+#define CRCSCAN_STATUS_OK       0x02
+#define CRCSCAN_TIMEOUT_MS      1000
+
+/*
+ * CRC-16-CCITT as computed by CRCSCAN: polynomial 0x1021, initial value
+ * 0xffff, MSB first; bytes not allocated in m count as 0xff
+ */
+static unsigned short crcscan_crc16(const AVRMEM *m, int len) {
+  unsigned short crc = 0xffff;
+  unsigned char c;
+  int i, b;
+
+  for (i = 0; i < len; i++) {
+    c = m->tags[i] & TAG_ALLOCATED? m->buf[i]: 0xff;
+    crc ^= c << 8;
+    for (b = 0; b < 8; b++)
+      crc = crc & 0x8000? (crc << 1) ^ 0x1021: crc << 1;
+  }
+
+  return crc;
+}
+
+/*
+ * Verify the flash of a UPDI part against the input file image in m
+ * with the on-chip CRCSCAN peripheral instead of reading it back.
+ *
+ * CRCSCAN only tells whether the flash agrees with the CRC-16 checksum
+ * stored big endian in its last two bytes.  The check is therefore
+ * only used when the image (0xff filled) carries a valid checksum; the
+ * device's checksum bytes are read back and compared with the image
+ * before the scan is started.  The read_data() and write_data()
+ * callbacks access the part's data space.
+ *
+ * Return 1 if the flash matches the image, 0 if it does not or if the
+ * image cannot be checked this way, and -1 on communication errors.
+ */
+int avr_crcscan_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int (*read_data)(const PROGRAMMER *pgm, unsigned long addr, unsigned char *value),
+  int (*write_data)(const PROGRAMMER *pgm, unsigned long addr, unsigned char value)) {
+
+  unsigned char csum[2], status;
+  struct timeval tv;
+  unsigned long start_ms, now_ms;
+  int i;
+
+  if (!(p->prog_modes & PM_UPDI) || strcmp(m->desc, "flash") != 0 || m->size < 2)
+    return 0;
+
+  if (crcscan_crc16(m, m->size) != 0) {
+    avrdude_message(MSG_NOTICE, "%s: input file has no CRCSCAN checksum at the end of flash, "
+      "reading back instead\n", progname);
+    return 0;
+  }
+
+  for (i = 0; i < 2; i++)
+    if (read_data(pgm, m->offset + m->size - 2 + i, csum + i) < 0)
+      return -1;
+  if (csum[0] != m->buf[m->size-2] || csum[1] != m->buf[m->size-1]) {
+    avrdude_message(MSG_NOTICE, "%s: on-chip flash checksum 0x%02x%02x differs from file\n",
+      progname, csum[0], csum[1]);
+    return 0;
+  }
+
+  if (write_data(pgm, CRCSCAN_CTRLA, CRCSCAN_CTRLA_RESET) < 0 ||
+      write_data(pgm, CRCSCAN_CTRLB, CRCSCAN_CTRLB_SRC_FLASH) < 0 ||
+      write_data(pgm, CRCSCAN_CTRLA, CRCSCAN_CTRLA_ENABLE) < 0)
+    return -1;
+
+  gettimeofday(&tv, NULL);
+  start_ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  do {
+    if (read_data(pgm, CRCSCAN_STATUS, &status) < 0)
+      return -1;
+    gettimeofday(&tv, NULL);
+    now_ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  } while ((status & CRCSCAN_STATUS_BUSY) && now_ms - start_ms < CRCSCAN_TIMEOUT_MS);
+
+  write_data(pgm, CRCSCAN_CTRLA, CRCSCAN_CTRLA_RESET);
+
+  if (status & CRCSCAN_STATUS_BUSY) {
+    avrdude_message(MSG_NOTICE, "%s: CRCSCAN did not complete, reading back instead\n", progname);
+    return 0;
+  }
+
+  avrdude_message(MSG_NOTICE, "%s: CRCSCAN of flash %s\n", progname,
+    status & CRCSCAN_STATUS_OK? "OK": "failed");
+
+  return (status & CRCSCAN_STATUS_OK) != 0;
+}
+
+
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles) {
   AVRMEM * a;
   unsigned int cycle_count = 0;
@@ -1324,15 +1536,27 @@ int avr_unlock(const PROGRAMMER *pgm, const AVRPART *p) {
  */
 
 void report_progress(int completed, int total, const char *hdr) {
-  static int last;
-  static double start_time;
+  static int last, last_total, tick_base, tick, ended;
+  static const char *phase;
+  static double start_time, last_event;
   int percent;
   struct timeval tv;
   double t;
 
-  if (update_progress == NULL)
+  if (update_progress == NULL && progress_event == NULL)
     return;
 
+  /*
+   * Only look at the clock once per tick, 1/1000 of the total, so that
+   * byte loops calling this for every byte stay cheap
+   */
+  if(!hdr && total == last_total && completed >= tick_base &&
+     completed < tick_base + tick && completed < total)
+    return;
+  last_total = total;
+  tick_base = completed;
+  tick = total > 1000? total/1000: 1;
+
   percent =
     completed >= total || total <= 0? 100:
     completed < 0? 0:
@@ -1344,8 +1568,49 @@ void report_progress(int completed, int total, const char *hdr) {
   if(hdr || !start_time)
     start_time = t;
 
-  if(hdr || percent > last) {
+  if(hdr) {
+    phase = hdr;
+    progress_retries = 0;
+    ended = 0;
+  }
+
+  if(update_progress && (hdr || percent > last)) {
     last = percent;
     update_progress(percent, t - start_time, hdr, total < 0? -1: !!total);
   }
+
+  if(progress_event && !ended) {
+    PROGRESS_EVENT ev;
+
+    ev.state = hdr? "start": total < 0? "failed": completed >= total? "done": "progress";
+    ended = !hdr && *ev.state != 'p';
+    if(hdr || ended || progress_event_hz <= 0 || t - last_event >= 1.0/progress_event_hz) {
+      last_event = t;
+      ev.phase = phase;
+      ev.memory = progress_memory;
+      ev.done = completed < 0? 0: completed;
+      ev.total = total < 0? 0: total;
+      ev.elapsed = t - start_time;
+      ev.rate = ev.elapsed > 0? ev.done/ev.elapsed: 0;
+      ev.eta = ended? 0: ev.rate > 0 && ev.total > ev.done? (ev.total - ev.done)/ev.rate: -1;
+      ev.retries = progress_retries;
+      progress_event(&ev);
+    }
+    if(ended)
+      progress_memory = NULL;
+  }
+}
+
+/*
+ * Name the memory that subsequent progress events refer to; call before
+ * report_progress(0, 1, hdr).  It is forgotten once the operation ends.
+ */
+void report_progress_memory(const char *memdesc) {
+  progress_memory = memdesc;
+}
+
+// Count a retry (eg, a failed write poll) for the current progress report
+void report_progress_retry(void) {
+  progress_retries++;
+  trace_instant("retry");
 }
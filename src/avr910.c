@@ -50,6 +50,7 @@ struct pdata
   unsigned int buffersize;
   unsigned char test_blockmode;
   unsigned char use_blockmode;
+  int eeprom_blocks;		/* 0: single bytes only, 1: block writes ok */
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -201,6 +202,8 @@ static int avr910_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
                       "buffersize = %u bytes.\n",
                       PDATA(pgm)->buffersize);
       PDATA(pgm)->use_blockmode = 1;
+      /* Trust the buffer to take EEPROM blocks as well, see avr910_paged_write() */
+      PDATA(pgm)->eeprom_blocks = PDATA(pgm)->buffersize > 1;
     } else {
       PDATA(pgm)->use_blockmode = 0;
     }
@@ -592,7 +595,8 @@ static int avr910_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
       return -2;
 
     if (m->desc[0] == 'e') {
-      blocksize = 1;		/* Write to eeprom single bytes only */
+      if (PDATA(pgm)->eeprom_blocks == 0)
+        blocksize = 1;		/* Write to eeprom single bytes only */
       wr_size = 1;
     } else {
       wr_size = 2;
@@ -615,7 +619,22 @@ static int avr910_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
       cmd[2] = blocksize & 0xff;
 
       avr910_send(pgm, cmd, 4 + blocksize);
-      avr910_vfy_cmd_sent(pgm, "write block");
+
+      if (m->desc[0] == 'e' && blocksize > 1) {
+        char c = 0;
+
+        /* A refused block may have been run as commands, eg, chip erase */
+        avr910_recv(pgm, &c, 1);
+        if (c != '\r') {
+          avrdude_message(MSG_INFO, "%s: avr910_paged_write(): programmer refused EEPROM block write; "
+                          "it may have run parts of the block as commands, check whether "
+                          "the device was erased or its lock bits changed\n", progname);
+          avr910_drain(pgm, 0);
+          free(cmd);
+          return -1;
+        }
+      } else
+        avr910_vfy_cmd_sent(pgm, "write block");
 
       addr += blocksize;
     } /* while */
@@ -749,6 +768,8 @@ void avr910_initpgm(PROGRAMMER *pgm) {
 
   pgm->paged_write = avr910_paged_write;
   pgm->paged_load = avr910_paged_load;
+  /* Runs of pages, eg, small EEPROM pages, go out in buffer-sized blocks */
+  pgm->max_paged_xfer = 1024;
 
   pgm->read_sig_bytes = avr910_read_sig_bytes;
 
@@ -130,8 +130,10 @@ int avr_read_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
   unsigned char *pagecopy = cfg_malloc("avr_read_page_default()", pgsize);
 
   memcpy(pagecopy, mem->buf + off, pgsize);
+  trace_begin("paged_load");
   if((rc = pgm->paged_load(pgm, p, mem, pgsize, off, pgsize)) >= 0)
     memcpy(buf, mem->buf + off, pgsize);
+  trace_end();
   memcpy(mem->buf + off, pagecopy, pgsize);
   free(pagecopy);
 
@@ -153,7 +155,9 @@ int avr_write_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
 
   memcpy(pagecopy, mem->buf + off, pgsize);
   memcpy(mem->buf + off, data, pgsize);
+  trace_begin("paged_write");
   rc = pgm->paged_write(pgm, p, mem, pgsize, off, pgsize);
+  trace_end();
   memcpy(mem->buf + off, pagecopy, pgsize);
   free(pagecopy);
 
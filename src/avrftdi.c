@@ -925,6 +925,12 @@ avrftdi_lext(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, unsigned
 	return 0;
 }
 
+/*
+ * Writing to EEPROM: on parts with EEPROM page commands, the load page
+ * frames for the whole page and the write page frame go out as one MPSSE
+ * command buffer; otherwise every byte is written on its own and the
+ * maximum write delay is waited after each
+ */
 static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
 		unsigned int page_size, unsigned int addr, unsigned int len)
 {
@@ -932,6 +938,58 @@ static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 	unsigned char *data = &m->buf[addr];
 	unsigned int add;
 
+	if (m->op[AVR_OP_LOADPAGE_LO] && m->op[AVR_OP_WRITEPAGE] && m->page_size > 1) {
+		unsigned int buf_size = 4 * len + 4;
+		unsigned char *buf = alloca(buf_size);
+		unsigned char *bufptr = buf;
+		unsigned int poll_index;
+		unsigned char poll_byte;
+		struct timeval tv;
+		unsigned long start_time, prog_time;
+
+		memset(buf, 0, buf_size);
+		for (add = addr; add < addr + len; add++) {
+			avr_set_bits(m->op[AVR_OP_LOADPAGE_LO], bufptr);
+			avr_set_addr(m->op[AVR_OP_LOADPAGE_LO], bufptr, add);
+			avr_set_input(m->op[AVR_OP_LOADPAGE_LO], bufptr, *data++);
+			bufptr += 4;
+		}
+		avr_set_bits(m->op[AVR_OP_WRITEPAGE], bufptr);
+		avr_set_addr(m->op[AVR_OP_WRITEPAGE], bufptr, addr);
+		bufptr += 4;
+
+		if(verbose > TRACE)
+			buf_dump(buf, buf_size, "eeprom command buffer", 0, 16*2);
+
+		if (0 > avrftdi_transmit(pgm, MPSSE_DO_WRITE, buf, buf, bufptr - buf))
+			return -1;
+
+		/* poll for a value the part does not return while busy, else wait */
+		for(poll_index = addr+len-1; poll_index+1 > addr; poll_index--)
+			if(m->buf[poll_index] != m->readback[0] && m->buf[poll_index] != m->readback[1])
+				break;
+
+		if(poll_index+1 > addr) {
+			gettimeofday(&tv, NULL);
+			start_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+			do {
+				if (pgm->read_byte(pgm, p, m, poll_index, &poll_byte) < 0)
+					return -1;
+				if (m->buf[poll_index] == poll_byte)
+					break;
+				gettimeofday(&tv, NULL);
+				prog_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+			} while (prog_time - start_time < (unsigned long) m->max_write_delay);
+			if (m->buf[poll_index] != poll_byte) {
+				log_err("EEPROM page write at 0x%04x timed out\n", addr);
+				return -1;
+			}
+		} else
+			usleep((m->max_write_delay));
+
+		return len;
+	}
+
 	avr_set_bits(m->op[AVR_OP_WRITE], cmd);
 
 	for (add = addr; add < addr + len; add++)
@@ -947,29 +1005,40 @@ static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 	return len;
 }
 
+/*
+ * Reading from EEPROM: the read frames for all bytes go out as one MPSSE
+ * command buffer and the replies come back in a single transfer
+ */
 static int avrftdi_eeprom_read(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
 		unsigned int page_size, unsigned int addr, unsigned int len)
 {
-	unsigned char cmd[4];
-	unsigned int add;
-	unsigned char* buffer = alloca(len);
-	unsigned char* bufptr = buffer;
-
-	memset(buffer, 0, len);
+	unsigned int buf_size = 4 * len;
+	unsigned char* o_buf = alloca(buf_size);
+	unsigned char* i_buf = alloca(buf_size);
+	unsigned int i;
 
-	for (add = addr; add < addr + len; add++)
-	{
-		memset(cmd, 0, sizeof(cmd));
-		avr_set_bits(m->op[AVR_OP_READ], cmd);
-		avr_set_addr(m->op[AVR_OP_READ], cmd, add);
+	if (m->op[AVR_OP_READ] == NULL) {
+		log_err("AVR_OP_READ command not defined for %s\n", p->desc);
+		return -1;
+	}
 
-		if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, cmd, cmd, 4))
-			return -1;
+	memset(o_buf, 0, buf_size);
+	memset(i_buf, 0, buf_size);
 
-		avr_get_output(m->op[AVR_OP_READ], cmd, bufptr++);
+	for (i = 0; i < len; i++) {
+		avr_set_bits(m->op[AVR_OP_READ], &o_buf[i*4]);
+		avr_set_addr(m->op[AVR_OP_READ], &o_buf[i*4], addr + i);
 	}
 
-	memcpy(m->buf + addr, buffer, len);
+	if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, o_buf, i_buf, buf_size))
+		return -1;
+
+	if(verbose > TRACE)
+		buf_dump(i_buf, buf_size, "i_buf", 0, 32);
+
+	for (i = 0; i < len; i++)
+		avr_get_output(m->op[AVR_OP_READ], &i_buf[i*4], &m->buf[addr + i]);
+
 	return len;
 }
 
@@ -34,10 +34,21 @@ OPCODE *avr_new_opcode(void) {
   return (OPCODE *) cfg_malloc("avr_new_opcode()", sizeof(OPCODE));
 }
 
+// Return the read-only copy of op shared by all parts and free op
+OPCODE *avr_intern_opcode(OPCODE *op) {
+  OPCODE *ret = (OPCODE *) cfg_intern(op, sizeof *op);
+
+  avr_free_opcode(op);
+  return ret;
+}
+
 static OPCODE *avr_dup_opcode(const OPCODE *op) {
   if(op == NULL)                // Caller wants NULL if op == NULL
     return NULL;
 
+  if(cfg_in_arena(op))          // Shared opcodes are never modified
+    return (OPCODE *) op;
+
   OPCODE *m = (OPCODE *) cfg_malloc("avr_dup_opcode()", sizeof(*m));
   memcpy(m, op, sizeof(*m));
 
@@ -45,7 +56,7 @@ static OPCODE *avr_dup_opcode(const OPCODE *op) {
 }
 
 void avr_free_opcode(OPCODE *op) {
-  if(op)
+  if(op && !cfg_in_arena(op))
     free(op);
 }
 
@@ -327,7 +338,7 @@ static char * bittype(int type)
  ***/
 
 AVRMEM *avr_new_memtype(void) {
-  AVRMEM *m = (AVRMEM *) cfg_malloc("avr_new_memtype()", sizeof(*m));
+  AVRMEM *m = (AVRMEM *) cfg_part_malloc("avr_new_memtype()", sizeof(*m));
   m->desc = cache_string("");
   m->page_size = 1; // ensure not 0
 
@@ -335,7 +346,7 @@ AVRMEM *avr_new_memtype(void) {
 }
 
 AVRMEM_ALIAS *avr_new_memalias(void) {
-  AVRMEM_ALIAS *m = (AVRMEM_ALIAS *) cfg_malloc("avr_new_memalias()", sizeof*m);
+  AVRMEM_ALIAS *m = (AVRMEM_ALIAS *) cfg_part_malloc("avr_new_memalias()", sizeof*m);
   m->desc = cache_string("");
   return m;
 }
@@ -409,11 +420,12 @@ void avr_free_mem(AVRMEM * m) {
       m->op[i] = NULL;
     }
   }
-  free(m);
+  if(!cfg_in_arena(m))
+    free(m);
 }
 
 void avr_free_memalias(AVRMEM_ALIAS *m) {
-  if(m)
+  if(m && !cfg_in_arena(m))
     free(m);
 }
 
@@ -568,7 +580,7 @@ void avr_mem_display(const char *prefix, FILE *f, const AVRMEM *m,
  */
 
 AVRPART *avr_new_part(void) {
-  AVRPART *p = (AVRPART *) cfg_malloc("avr_new_part()", sizeof(AVRPART));
+  AVRPART *p = (AVRPART *) cfg_part_malloc("avr_new_part()", sizeof(AVRPART));
   const char *nulp = cache_string("");
 
   memset(p, 0, sizeof(*p));
@@ -643,7 +655,8 @@ void avr_free_part(AVRPART * d)
       d->op[i] = NULL;
     }
   }
-  free(d);
+  if(!cfg_in_arena(d))
+    free(d);
 }
 
 AVRPART *locate_part(const LISTID parts, const char *partdesc) {
@@ -0,0 +1,161 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2022 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Per-port cache of serial baud rates found by programmers that
+ * support automatic baud rate negotiation
+ *
+ * long serial_baud_cache_get(const char *port);
+ *
+ * void serial_baud_cache_put(const char *port, long baud);
+ *
+ * The cache is a small text file in the user's home directory with one
+ * "<port> <baud>" line per port.  serial_baud_cache_get() returns 0 if
+ * there is no entry for the port.  serial_baud_cache_put() replaces
+ * the entry for the port, or removes it if baud is 0.  Any problem
+ * accessing the file is silently ignored; the cache is only a hint to
+ * speed up the next negotiation.
+ */
+
+#include "ac_cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#if defined(WIN32)
+#define BAUD_CACHE_HOME "USERPROFILE"
+#define BAUD_CACHE_FILE "avrdude_baud.txt"
+#define BAUD_CACHE_SEP  "\\"
+#else
+#define BAUD_CACHE_HOME "HOME"
+#define BAUD_CACHE_FILE ".avrdude_baud"
+#define BAUD_CACHE_SEP  "/"
+#endif
+
+#define BAUD_CACHE_MAX_ENTRIES 32
+
+typedef struct {
+  char port[PATH_MAX];
+  long baud;
+} baud_cache_entry;
+
+static int baud_cache_path(char *path, size_t size) {
+  const char *home = getenv(BAUD_CACHE_HOME);
+
+  if (home == NULL || *home == 0)
+    return -1;
+
+  if (strlen(home) + strlen(BAUD_CACHE_SEP) + strlen(BAUD_CACHE_FILE) >= size)
+    return -1;
+
+  strcpy(path, home);
+  if (path[strlen(path)-1] != *BAUD_CACHE_SEP)
+    strcat(path, BAUD_CACHE_SEP);
+  strcat(path, BAUD_CACHE_FILE);
+
+  return 0;
+}
+
+// Read up to BAUD_CACHE_MAX_ENTRIES entries, return their number
+static int baud_cache_read(const char *path, baud_cache_entry *entries) {
+  char line[PATH_MAX + 32];
+  int n = 0;
+  FILE *f;
+
+  if ((f = fopen(path, "r")) == NULL)
+    return 0;
+
+  while (n < BAUD_CACHE_MAX_ENTRIES && fgets(line, sizeof line, f)) {
+    char *sp = strrchr(line, ' ');
+    long baud;
+
+    if (sp == NULL || sp == line || sp - line >= PATH_MAX)
+      continue;
+    if ((baud = strtol(sp+1, NULL, 10)) <= 0)
+      continue;
+
+    memcpy(entries[n].port, line, sp - line);
+    entries[n].port[sp - line] = 0;
+    entries[n].baud = baud;
+    n++;
+  }
+  fclose(f);
+
+  return n;
+}
+
+long serial_baud_cache_get(const char *port) {
+  baud_cache_entry entries[BAUD_CACHE_MAX_ENTRIES];
+  char path[PATH_MAX];
+  int i, n;
+
+  if (port == NULL || baud_cache_path(path, sizeof path) < 0)
+    return 0;
+
+  n = baud_cache_read(path, entries);
+  for (i = 0; i < n; i++)
+    if (strcmp(entries[i].port, port) == 0) {
+      avrdude_message(MSG_DEBUG, "%s: cached baud rate for %s is %ld\n",
+        progname, port, entries[i].baud);
+      return entries[i].baud;
+    }
+
+  return 0;
+}
+
+void serial_baud_cache_put(const char *port, long baud) {
+  baud_cache_entry entries[BAUD_CACHE_MAX_ENTRIES];
+  char path[PATH_MAX];
+  int i, n;
+  FILE *f;
+
+  if (port == NULL || strlen(port) >= PATH_MAX || baud_cache_path(path, sizeof path) < 0)
+    return;
+
+  n = baud_cache_read(path, entries);
+
+  // Drop the old entry for this port, keeping the most recent ones
+  for (i = 0; i < n; i++)
+    if (strcmp(entries[i].port, port) == 0) {
+      if (entries[i].baud == baud)
+        return;
+      memmove(entries+i, entries+i+1, (n-i-1) * sizeof *entries);
+      n--;
+      break;
+    }
+  if (n == BAUD_CACHE_MAX_ENTRIES) {
+    memmove(entries, entries+1, (n-1) * sizeof *entries);
+    n--;
+  }
+
+  if ((f = fopen(path, "w")) == NULL) {
+    avrdude_message(MSG_DEBUG, "%s: cannot write baud rate cache %s\n", progname, path);
+    return;
+  }
+  for (i = 0; i < n; i++)
+    fprintf(f, "%s %ld\n", entries[i].port, entries[i].baud);
+  if (baud > 0)
+    fprintf(f, "%s %ld\n", port, baud);
+  fclose(f);
+}
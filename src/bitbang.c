@@ -27,13 +27,13 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #if defined(WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #else
 #include <signal.h>
-#include <sys/time.h>
 #endif
 
 #include "avrdude.h"
@@ -380,6 +380,59 @@ int bitbang_cmd_tpi(const PROGRAMMER *pgm, const unsigned char *cmd,
   return 0;
 }
 
+/*
+ * execute a stream of TPI instructions, see tpi_insn_len(); the
+ * responses of all instructions that produce one go to res[]
+ */
+int bitbang_cmd_tpi_block(const PROGRAMMER *pgm, const unsigned char *cmd,
+                          int cmd_len, unsigned char *res, int res_len)
+{
+  int i, j, n, nres, r, rx;
+
+  pgm->pgm_led(pgm, ON);
+
+  r = 0;
+  for (i = rx = 0; i < cmd_len && r != -1; i += n) {
+    n = tpi_insn_len(cmd[i], &nres);
+    if (i + n > cmd_len || rx + nres > res_len) {
+      r = -1;
+      break;
+    }
+
+    if (cmd[i] == TPI_BLOCK_DELAY) {
+      /* TPI is synchronous: not clocking keeps the link idle */
+      usleep(cmd[i+1] * TPI_BLOCK_DELAY_UNIT);
+      continue;
+    }
+
+    for (j = 0; j < n; j++)
+      bitbang_tpi_tx(pgm, cmd[i+j]);
+
+    for (j = 0; j < nres; j++) {
+      r = bitbang_tpi_rx(pgm);
+      if (r == -1)
+        break;
+      res[rx++] = r;
+    }
+  }
+
+  if(verbose >= 2)
+  {
+    avrdude_message(MSG_NOTICE2, "bitbang_cmd_tpi_block(): [ ");
+    for(i = 0; i < cmd_len; i++)
+      avrdude_message(MSG_NOTICE2, "%02X ", cmd[i]);
+    avrdude_message(MSG_NOTICE2, "] [ ");
+    for(i = 0; i < rx; i++)
+      avrdude_message(MSG_NOTICE2, "%02X ", res[i]);
+    avrdude_message(MSG_NOTICE2, "]\n");
+  }
+
+  pgm->pgm_led(pgm, OFF);
+  if (r == -1)
+    return -1;
+  return 0;
+}
+
 /*
  * transmit bytes via SPI and return the results; 'cmd' and
  * 'res' must point to data buffers
@@ -414,6 +467,208 @@ int bitbang_spi(const PROGRAMMER *pgm, const unsigned char *cmd,
 }
 
 
+/*
+ * Page-level ISP engine for the bitbang programmers
+ *
+ * avr_read_byte_default() and avr_write_byte_default() rebuild the
+ * opcode bit pattern, reissue the load extended address command and
+ * toggle the LEDs for every single byte, and avr_write_page() waits the
+ * worst-case write time after each page.  The functions below set up
+ * the command templates once per call, only send a load extended
+ * address command when crossing a 64 K word boundary, and data-poll a
+ * byte of each page written instead of sleeping max_write_delay.
+ */
+
+/*
+ * send a complete 4-byte ISP command without the per-command
+ * verbose dump of bitbang_cmd()
+ */
+static void bitbang_isp_cmd(const PROGRAMMER *pgm, const unsigned char *cmd,
+                            unsigned char *res)
+{
+  int i;
+
+  for (i=0; i<4; i++)
+    res[i] = bitbang_txrx(pgm, cmd[i]);
+}
+
+/*
+ * issue the load extended address command for word (or byte) address
+ * addr if it is needed and the high address byte has changed
+ */
+static void bitbang_load_ext_addr(const PROGRAMMER *pgm, const AVRMEM *m,
+                                  unsigned long addr, unsigned long *hiaddr)
+{
+  unsigned char cmd[4], res[4];
+  OPCODE *lext = m->op[AVR_OP_LOAD_EXT_ADDR];
+
+  if (lext == NULL || *hiaddr == (addr >> 16))
+    return;
+
+  *hiaddr = addr >> 16;
+  memset(cmd, 0, sizeof(cmd));
+  avr_set_bits(lext, cmd);
+  avr_set_addr(lext, cmd, addr);
+  bitbang_isp_cmd(pgm, cmd, res);
+}
+
+/*
+ * read n_bytes of memory m starting at addr into m->buf
+ */
+int bitbang_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                       unsigned int page_size,
+                       unsigned int addr, unsigned int n_bytes)
+{
+  unsigned char tmpl[2][4], cmd[4], res[4];
+  unsigned long caddr, hiaddr = ULONG_MAX;
+  unsigned int end = addr + n_bytes;
+  OPCODE *rop[2];
+  int i, wordmem, hi;
+
+  if (p->prog_modes & PM_TPI)
+    return -1;
+
+  wordmem = m->op[AVR_OP_READ_LO] != NULL;
+  rop[0] = wordmem? m->op[AVR_OP_READ_LO]: m->op[AVR_OP_READ];
+  rop[1] = wordmem? m->op[AVR_OP_READ_HI]: m->op[AVR_OP_READ];
+  if (rop[0] == NULL || rop[1] == NULL)
+    return -1;
+
+  for (i=0; i<2; i++) {
+    memset(tmpl[i], 0, sizeof(tmpl[i]));
+    avr_set_bits(rop[i], tmpl[i]);
+  }
+
+  pgm->pgm_led(pgm, ON);
+  pgm->err_led(pgm, OFF);
+
+  for (; addr < end; addr++) {
+    hi = wordmem && (addr & 1);
+    caddr = wordmem? addr/2: addr;
+    bitbang_load_ext_addr(pgm, m, caddr, &hiaddr);
+
+    memcpy(cmd, tmpl[hi], sizeof(cmd));
+    avr_set_addr(rop[hi], cmd, caddr);
+    bitbang_isp_cmd(pgm, cmd, res);
+    m->buf[addr] = 0;
+    avr_get_output(rop[hi], res, m->buf + addr);
+  }
+
+  pgm->pgm_led(pgm, OFF);
+
+  return n_bytes;
+}
+
+/*
+ * wait for the page write of bytes lo..hi-1 to complete: poll the last
+ * byte whose value can be told apart from the polled read-back values,
+ * or wait the maximum write delay if there is none
+ */
+static void bitbang_page_wait(const PROGRAMMER *pgm, const AVRPART *p,
+                              const AVRMEM *m, unsigned int lo, unsigned int hi)
+{
+  struct timeval tv;
+  unsigned long start_time, prog_time;
+  unsigned int a;
+  unsigned char r;
+  int found = 0;
+
+  for (a = hi; !found && a > lo; )
+    if (m->buf[--a] != m->readback[0] && m->buf[a] != m->readback[1])
+      found = 1;
+
+  if (!found) {
+    usleep(m->max_write_delay);
+    return;
+  }
+
+  gettimeofday(&tv, NULL);
+  start_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+  do {
+    if (avr_read_byte_default(pgm, p, m, a, &r) != 0) {
+      usleep(m->max_write_delay);
+      return;
+    }
+    gettimeofday(&tv, NULL);
+    prog_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+  } while (r != m->buf[a] && prog_time - start_time < (unsigned long) m->max_write_delay);
+}
+
+/*
+ * write n_bytes of memory m from m->buf starting at addr; paged
+ * memories are filled through the load page opcodes and committed once
+ * per page, all other memories are written byte by byte
+ */
+int bitbang_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                        unsigned int page_size,
+                        unsigned int addr, unsigned int n_bytes)
+{
+  unsigned char tmpl[2][4], cmd[4], res[4];
+  unsigned long hiaddr = ULONG_MAX;
+  unsigned int end = addr + n_bytes, pagebase, pageend;
+  OPCODE *lop[2], *wp;
+  int i, hi;
+
+  if (p->prog_modes & PM_TPI)
+    return -1;
+
+  if (!m->paged) {
+    for (; addr < end; addr++)
+      if (avr_write_byte_default(pgm, p, m, addr, m->buf[addr]) != 0)
+        return -1;
+    return n_bytes;
+  }
+
+  lop[0] = m->op[AVR_OP_LOADPAGE_LO];
+  lop[1] = m->op[AVR_OP_LOADPAGE_HI];
+  wp = m->op[AVR_OP_WRITEPAGE];
+  if (lop[0] == NULL || wp == NULL)
+    return -1;
+
+  for (i=0; i<2; i++) {
+    memset(tmpl[i], 0, sizeof(tmpl[i]));
+    if (lop[i])
+      avr_set_bits(lop[i], tmpl[i]);
+  }
+
+  for (; addr < end; addr = pageend) {
+    pagebase = addr - addr % m->page_size;
+    pageend = pagebase + m->page_size < end? pagebase + m->page_size: end;
+
+    pgm->pgm_led(pgm, ON);
+    pgm->err_led(pgm, OFF);
+
+    // fill the page buffer
+    for (; addr < pageend; addr++) {
+      hi = addr & 1;
+      if (lop[hi] == NULL) {
+        pgm->pgm_led(pgm, OFF);
+        return -1;
+      }
+      memcpy(cmd, tmpl[hi], sizeof(cmd));
+      avr_set_addr(lop[hi], cmd, addr/2);
+      avr_set_input(lop[hi], cmd, m->buf[addr]);
+      bitbang_isp_cmd(pgm, cmd, res);
+    }
+
+    // commit the page
+    bitbang_load_ext_addr(pgm, m, pagebase/2, &hiaddr);
+    memset(cmd, 0, sizeof(cmd));
+    avr_set_bits(wp, cmd);
+    avr_set_addr(wp, cmd, pagebase/2);
+    bitbang_isp_cmd(pgm, cmd, res);
+
+    bitbang_page_wait(pgm, p, m, pagebase, pageend);
+    /* avr_read_byte_default() may have changed the extended address */
+    hiaddr = ULONG_MAX;
+
+    pgm->pgm_led(pgm, OFF);
+  }
+
+  return n_bytes;
+}
+
+
 /*
  * issue the 'chip erase' command to the AVR device
  */
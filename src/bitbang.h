@@ -41,8 +41,16 @@ int  bitbang_cmd            (const PROGRAMMER *pgm, const unsigned char *cmd,
                                 unsigned char *res);
 int  bitbang_cmd_tpi        (const PROGRAMMER *pgm, const unsigned char *cmd,
                                 int cmd_len, unsigned char *res, int res_len);
+int  bitbang_cmd_tpi_block  (const PROGRAMMER *pgm, const unsigned char *cmd,
+                                int cmd_len, unsigned char *res, int res_len);
 int  bitbang_spi            (const PROGRAMMER *pgm, const unsigned char *cmd,
                                 unsigned char *res, int count);
+int  bitbang_paged_load     (const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                                unsigned int page_size,
+                                unsigned int addr, unsigned int n_bytes);
+int  bitbang_paged_write    (const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                                unsigned int page_size,
+                                unsigned int addr, unsigned int n_bytes);
 int  bitbang_chip_erase     (const PROGRAMMER *pgm, const AVRPART *p);
 int  bitbang_program_enable (const PROGRAMMER *pgm, const AVRPART *p);
 void bitbang_powerup        (const PROGRAMMER *pgm);
@@ -1323,6 +1323,7 @@ void buspirate_bb_initpgm(PROGRAMMER *pgm) {
 	pgm->chip_erase     = bitbang_chip_erase;
 	pgm->cmd            = bitbang_cmd;
 	pgm->cmd_tpi        = bitbang_cmd_tpi;
+	pgm->cmd_tpi_block  = bitbang_cmd_tpi_block;
 	pgm->powerup        = buspirate_bb_powerup;
 	pgm->powerdown      = buspirate_bb_powerdown;
 	pgm->setpin         = buspirate_bb_setpin;
@@ -1330,4 +1331,6 @@ void buspirate_bb_initpgm(PROGRAMMER *pgm) {
 	pgm->highpulsepin   = buspirate_bb_highpulsepin;
 	pgm->read_byte      = avr_read_byte_default;
 	pgm->write_byte     = avr_write_byte_default;
+	pgm->paged_load     = bitbang_paged_load;
+	pgm->paged_write    = bitbang_paged_write;
 }
@@ -56,6 +56,7 @@ struct pdata
 {
   char has_auto_incr_addr;
   unsigned int buffersize;
+  int eeprom_blocks;		/* 0: single bytes only, 1: block writes ok */
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -309,6 +310,15 @@ static int butterfly_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
   avrdude_message(MSG_INFO, "Programmer supports buffered memory access with buffersize=%i bytes.\n",
                   PDATA(pgm)->buffersize);
 
+  /*
+   * AVR109 buffers EEPROM blocks the same way as flash blocks, so the
+   * buffer size also decides how EEPROM is written.  This trusts the
+   * bootloader: one that only takes single EEPROM bytes would read the
+   * rest of a block as commands, which butterfly_paged_write() can only
+   * report afterwards.
+   */
+  PDATA(pgm)->eeprom_blocks = PDATA(pgm)->buffersize > 1;
+
   /* Get list of devices that the programmer supports. */
 
   butterfly_send(pgm, "t", 1);
@@ -603,8 +613,11 @@ static int butterfly_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
       strcmp(m->desc, "usersig"))
     return -2;
 
-  if (m->desc[0] == 'e')
-    wr_size = blocksize = 1;		/* Write to eeprom single bytes only */
+  if (m->desc[0] == 'e') {
+    wr_size = 1;
+    if (PDATA(pgm)->eeprom_blocks == 0)
+      blocksize = 1;			/* Write to eeprom single bytes only */
+  }
 
   if (use_ext_addr) {
     butterfly_set_extaddr(pgm, addr / wr_size);
@@ -633,8 +646,27 @@ static int butterfly_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     cmd[2] = blocksize & 0xff;
 
     butterfly_send(pgm, cmd, 4+blocksize);
-    if (butterfly_vfy_cmd_sent(pgm, "write block") < 0)
+
+    if (m->desc[0] == 'e' && blocksize > 1) {
+      char c = 0;
+
+      /*
+       * A refused block may have been taken as a sequence of commands,
+       * eg, 'e' (chip erase) or 'l' (write lock bits): do not carry on
+       */
+      butterfly_recv(pgm, &c, 1);
+      if (c != '\r') {
+        avrdude_message(MSG_INFO, "%s: butterfly_paged_write(): bootloader refused EEPROM block write; "
+                        "it may have run parts of the block as commands, check whether "
+                        "the device was erased or its lock bits changed\n", progname);
+        butterfly_drain(pgm, 0);
+        free(cmd);
+        return -1;
+      }
+    } else if (butterfly_vfy_cmd_sent(pgm, "write block") < 0) {
+      free(cmd);
       return -1;
+    }
 
     addr += blocksize;
   } /* while */
@@ -743,6 +775,8 @@ void butterfly_initpgm(PROGRAMMER *pgm) {
   pgm->page_erase = butterfly_page_erase;
   pgm->paged_write = butterfly_paged_write;
   pgm->paged_load = butterfly_paged_load;
+  /* Runs of pages, eg, small EEPROM pages, go out in buffer-sized blocks */
+  pgm->max_paged_xfer = 1024;
 
   pgm->read_sig_bytes = butterfly_read_sig_bytes;
 
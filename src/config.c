@@ -80,6 +80,7 @@ void cleanup_config(void)
   ldestroy_cb(programmers, (void(*)(void*))pgm_free);
   ldestroy_cb(string_list, (void(*)(void*))free_token);
   ldestroy_cb(number_list, (void(*)(void*))free_token);
+  cfg_arena_release();
 }
 
 int init_config(void)
@@ -131,6 +132,137 @@ char *cfg_strdup(const char *funcname, const char *s) {
 }
 
 
+/*
+ * Arena for objects that live as long as the configuration, ie, parts,
+ * their memories and the opcodes they share.  Allocations are carved
+ * from large chunks, are never freed one by one and are released all
+ * at once by cleanup_config().  Free functions of such objects check
+ * cfg_in_arena() and leave arena memory alone.
+ */
+
+#define CFG_ARENA_CHUNK (256*1024)
+#define CFG_ARENA_ALIGN 16
+
+typedef struct cfg_chunk {
+  struct cfg_chunk *next;
+  size_t size, used;
+  unsigned char *data;
+} Cfg_chunk;
+
+static Cfg_chunk *cfg_arena;
+static int cfg_arena_on;        // Part objects go into the arena while reading config files
+static unsigned long cfg_arena_nobj, cfg_arena_nbytes, cfg_arena_nchunks;
+
+// Table of shared objects for cfg_intern(), open addressing
+typedef struct {
+  unsigned long hash;
+  size_t n;
+  const void *obj;
+} Cfg_interned;
+
+static Cfg_interned *cfg_itab;
+static size_t cfg_itab_size, cfg_itab_used;
+static unsigned long cfg_intern_calls;
+
+void *cfg_arena_malloc(const char *funcname, size_t n) {
+  Cfg_chunk *c = cfg_arena;
+  void *ret;
+
+  n = (n + CFG_ARENA_ALIGN-1) & ~(size_t) (CFG_ARENA_ALIGN-1);
+  if(!c || c->size - c->used < n) {
+    size_t size = n > CFG_ARENA_CHUNK? n: CFG_ARENA_CHUNK;
+
+    c = cfg_malloc(funcname, sizeof *c + CFG_ARENA_ALIGN + size);
+    c->data = (unsigned char *) (((uintptr_t) (c+1) + CFG_ARENA_ALIGN-1) & ~(uintptr_t) (CFG_ARENA_ALIGN-1));
+    c->size = size;
+    c->next = cfg_arena;
+    cfg_arena = c;
+    cfg_arena_nchunks++;
+  }
+
+  ret = c->data + c->used;      // Chunk was zeroed by cfg_malloc()
+  c->used += n;
+  cfg_arena_nobj++;
+  cfg_arena_nbytes += n;
+
+  return ret;
+}
+
+// Allocate a part, memory or memory alias: in the arena while reading config files
+void *cfg_part_malloc(const char *funcname, size_t n) {
+  return cfg_arena_on? cfg_arena_malloc(funcname, n): cfg_malloc(funcname, n);
+}
+
+int cfg_in_arena(const void *p) {
+  for(Cfg_chunk *c = cfg_arena; c; c = c->next)
+    if((const unsigned char *) p >= c->data && (const unsigned char *) p < c->data + c->size)
+      return 1;
+
+  return 0;
+}
+
+static unsigned long cfg_hash(const void *obj, size_t n) {
+  const unsigned char *s = obj;
+  unsigned long h = 2166136261UL; // FNV-1a
+
+  while(n--)
+    h = (h ^ *s++) * 16777619UL;
+
+  return h;
+}
+
+/*
+ * Return a read-only arena copy of the n-byte object obj that is shared
+ * by all objects of the same content
+ */
+const void *cfg_intern(const void *obj, size_t n) {
+  unsigned long h = cfg_hash(obj, n);
+  size_t i;
+
+  cfg_intern_calls++;
+  if(2*(cfg_itab_used+1) > cfg_itab_size) { // Keep load factor at most 1/2
+    Cfg_interned *old = cfg_itab;
+    size_t oldsize = cfg_itab_size;
+
+    cfg_itab_size = oldsize? 2*oldsize: 1024;
+    cfg_itab = cfg_malloc("cfg_intern()", cfg_itab_size * sizeof *cfg_itab);
+    for(size_t k = 0; k < oldsize; k++)
+      if(old[k].obj) {
+        for(i = old[k].hash & (cfg_itab_size-1); cfg_itab[i].obj; i = (i+1) & (cfg_itab_size-1))
+          continue;
+        cfg_itab[i] = old[k];
+      }
+    free(old);
+  }
+
+  for(i = h & (cfg_itab_size-1); cfg_itab[i].obj; i = (i+1) & (cfg_itab_size-1))
+    if(cfg_itab[i].hash == h && cfg_itab[i].n == n && memcmp(cfg_itab[i].obj, obj, n) == 0)
+      return cfg_itab[i].obj;
+
+  void *copy = cfg_arena_malloc("cfg_intern()", n);
+  memcpy(copy, obj, n);
+  cfg_itab[i].hash = h;
+  cfg_itab[i].n = n;
+  cfg_itab[i].obj = copy;
+  cfg_itab_used++;
+
+  return copy;
+}
+
+// Release all arena memory at once
+void cfg_arena_release(void) {
+  while(cfg_arena) {
+    Cfg_chunk *c = cfg_arena;
+    cfg_arena = c->next;
+    free(c);
+  }
+  free(cfg_itab);
+  cfg_itab = NULL;
+  cfg_itab_size = cfg_itab_used = 0;
+  cfg_intern_calls = cfg_arena_nobj = cfg_arena_nbytes = cfg_arena_nchunks = 0;
+}
+
+
 int yywrap()
 {
   return 1;
@@ -368,7 +500,14 @@ int read_config(const char * file)
   cfg_lineno = 1;
   yyin   = f;
 
+  cfg_arena_on = 1;
   r = yyparse();
+  cfg_arena_on = 0;
+
+  avrdude_message(MSG_DEBUG, "%s: config arena holds %lu objects, %lu bytes in %lu chunk%s; "
+    "%lu opcodes share %lu copies\n", progname, cfg_arena_nobj, cfg_arena_nbytes,
+    cfg_arena_nchunks, cfg_arena_nchunks == 1? "": "s",
+    cfg_intern_calls, (unsigned long) cfg_itab_used);
 
 #ifdef HAVE_YYLEX_DESTROY
   /* reset lexer and free any allocated memory */
@@ -1354,7 +1354,7 @@ part_parm :
         /*yywarning("operation redefined");*/
         avr_free_opcode(current_part->op[opnum]);
       }
-      current_part->op[opnum] = op;
+      current_part->op[opnum] = avr_intern_opcode(op);
 
       free_token($1);
     }
@@ -1514,7 +1514,7 @@ mem_spec :
         /*yywarning("operation redefined");*/
         avr_free_opcode(current_mem->op[opnum]);
       }
-      current_mem->op[opnum] = op;
+      current_mem->op[opnum] = avr_intern_opcode(op);
 
       free_token($1);
     }
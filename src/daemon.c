@@ -0,0 +1,602 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2022 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Keep the programmer opened and initialised behind a local Unix socket
+ *
+ * int daemon_serve(PROGRAMMER *pgm, struct avrpart *p, const char *path);
+ *
+ * int daemon_client(const char *path, LISTID ops, int terminal,
+ *   enum updateflags flags, int erase, int stop);
+ *
+ * daemon_serve() listens on the socket path and runs the requests of one
+ * client after the other against the part until a client asks it to stop
+ * or it receives SIGINT or SIGTERM.  daemon_client() sends the -U
+ * operations in ops (a list of the strings given on the command line)
+ * and, if terminal is set, the terminal commands typed by the user to
+ * the daemon and copies the daemon's output to stderr.
+ *
+ * A request is a sequence of text lines terminated by a line ".":
+ *
+ *   D <dir>                      Directory for relative file names
+ *   F <flags> <verbose> <quell>  Update flags and message levels
+ *   E                            Chip erase
+ *   B <filename>                 Base image for delta programming, see --base
+ *   U <memtype>:r|w|v:<filename>[:format]
+ *   T <command>                  Terminal command
+ *   Q                            Stop the daemon after this request
+ *
+ * The daemon answers with the output of the request followed by a \001
+ * byte and the return code on a line of its own.  The flash and EEPROM
+ * cache of the terminal persists between requests, but pending writes
+ * are synchronised with the device at the end of each request.  The
+ * cache is invalidated by -U operations and chip erases, which bypass
+ * it, by the terminal command abort and when a failed request causes
+ * the part to be initialised anew.
+ */
+
+#include "ac_cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#include "daemon.h"
+#include "term.h"
+
+#if defined(WIN32)
+
+int daemon_serve(PROGRAMMER *pgm, struct avrpart *p, const char *path) {
+  avrdude_message(MSG_INFO, "%s: daemon mode is not supported on this platform\n", progname);
+  return -1;
+}
+
+int daemon_client(const char *path, LISTID ops, int terminal, enum updateflags flags,
+  int erase, int stop) {
+
+  avrdude_message(MSG_INFO, "%s: daemon mode is not supported on this platform\n", progname);
+  return -1;
+}
+
+#else
+
+#define DAEMON_STATUS '\001'
+
+typedef struct {
+  char *dir;
+  char *base;                   // --base file
+  enum updateflags flags;
+  int verbose, quell;
+  int erase, stop, bad;
+  LISTID ops;                   // -U strings
+  LISTID lines;                 // Terminal commands
+} daemon_request;
+
+static volatile sig_atomic_t daemon_stop;
+
+static void daemon_signal(int sig) {
+  daemon_stop = 1;
+}
+
+static int daemon_address(struct sockaddr_un *sa, const char *path) {
+  memset(sa, 0, sizeof *sa);
+  sa->sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof sa->sun_path) {
+    avrdude_message(MSG_INFO, "%s: socket path %s is too long\n", progname, path);
+    return -1;
+  }
+  strcpy(sa->sun_path, path);
+
+  return 0;
+}
+
+static void daemon_request_free(daemon_request *req) {
+  free(req->dir);
+  free(req->base);
+  if(req->ops)
+    ldestroy_cb(req->ops, free);
+  if(req->lines)
+    ldestroy_cb(req->lines, free);
+  memset(req, 0, sizeof *req);
+}
+
+static void daemon_request_init(daemon_request *req) {
+  memset(req, 0, sizeof *req);
+  req->flags = UF_AUTO_ERASE | UF_VERIFY;
+  req->verbose = verbose;
+  req->quell = quell_progress;
+  req->ops = lcreat(NULL, 0);
+  req->lines = lcreat(NULL, 0);
+}
+
+// Add one line other than "." to the request
+static void daemon_request_line(daemon_request *req, const char *line) {
+  const char *arg = line[0] && line[1] == ' '? line+2: line+1;
+  int flags;
+  char *s;
+
+  if(line[0] && line[1] && line[1] != ' ') {
+    req->bad = 1;
+    return;
+  }
+
+  switch(*line) {
+  case 'D':
+    free(req->dir);
+    req->dir = strdup(arg);
+    break;
+  case 'F':
+    if(sscanf(arg, "%d %d %d", &flags, &req->verbose, &req->quell) != 3)
+      req->bad = 1;
+    else
+      req->flags = flags;
+    break;
+  case 'E':
+    req->erase = 1;
+    break;
+  case 'B':
+    free(req->base);
+    if((req->base = strdup(arg)) == NULL)
+      req->bad = 1;
+    break;
+  case 'U':
+  case 'T':
+    if((s = strdup(arg)) == NULL)
+      req->bad = 1;
+    else
+      ladd(*line == 'U'? req->ops: req->lines, s);
+    break;
+  case 'Q':
+    req->stop = 1;
+    break;
+  default:
+    req->bad = 1;
+  }
+}
+
+// Same rule as on the command line: writing to flash implies a chip erase
+static int daemon_auto_erase(PROGRAMMER *pgm, struct avrpart *p, LISTID updates,
+  enum updateflags *flags) {
+
+  const char *memname = p->prog_modes & PM_PDI? "application": "flash";
+
+  if(update_base || ((p->prog_modes & PM_PDI) && pgm->page_erase))
+    return 0;
+
+  *flags &= ~UF_AUTO_ERASE;
+  for(LNODEID ln = lfirst(updates); ln; ln = lnext(ln)) {
+    UPDATE *upd = ldata(ln);
+    AVRMEM *m = avr_locate_mem(p, upd->memtype);
+
+    if(m && strcmp(m->desc, memname) == 0 && upd->op == DEVICE_WRITE) {
+      if(quell_progress < 2)
+        avrdude_message(MSG_INFO, "%s: NOTE: \"%s\" memory has been specified, an erase cycle "
+          "will be performed\n", progname, memname);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Run the request with stdout and stderr redirected to the client
+static int daemon_run(PROGRAMMER *pgm, struct avrpart *p, daemon_request *req, int fd) {
+  FP_UpdateProgress saved_progress = update_progress;
+  const char *saved_base = update_base;
+  int saved_verbose = verbose, saved_quell = quell_progress;
+  int savedout, savederr, cwd, rc = 0, failed = 0;
+  LISTID updates = lcreat(NULL, 0);
+
+  fflush(stdout);
+  fflush(stderr);
+  savedout = dup(STDOUT_FILENO);
+  savederr = dup(STDERR_FILENO);
+  cwd = open(".", O_RDONLY);
+  if(updates == NULL || savedout < 0 || savederr < 0 || cwd < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot set up request: %s\n", progname, strerror(errno));
+    if(updates)
+      ldestroy(updates);
+    if(savedout >= 0)
+      close(savedout);
+    if(savederr >= 0)
+      close(savederr);
+    if(cwd >= 0)
+      close(cwd);
+    return -1;
+  }
+
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+  verbose = req->verbose;
+  quell_progress = req->quell;
+  update_base = req->base;
+  if(quell_progress > 0)
+    update_progress = NULL;
+  else
+    terminal_setup_update_progress();
+
+  trace_begin("request");
+  if(req->bad) {
+    avrdude_message(MSG_INFO, "%s: invalid request from client\n", progname);
+    rc = -1;
+    goto done;
+  }
+
+  if(req->dir && chdir(req->dir) < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot change to directory %s: %s\n",
+      progname, req->dir, strerror(errno));
+    rc = -1;
+    goto done;
+  }
+
+  for(LNODEID ln = lfirst(req->ops); ln; ln = lnext(ln)) {
+    UPDATE *upd = parse_op(ldata(ln));
+
+    if(upd == NULL) {
+      avrdude_message(MSG_INFO, "%s: error parsing update operation '%s'\n",
+        progname, (char *) ldata(ln));
+      rc = -1;
+      goto done;
+    }
+    ladd(updates, upd);
+  }
+
+  // Same as on the command line: expand all and fill in the default memory
+  if(update_expand_all(p, updates) < 0) {
+    rc = -1;
+    goto done;
+  }
+  for(LNODEID ln = lfirst(updates); ln; ln = lnext(ln)) {
+    UPDATE *upd = ldata(ln);
+
+    if(upd->memtype == NULL)
+      upd->memtype = cfg_strdup("daemon_run()", p->prog_modes & PM_PDI? "application": "flash");
+  }
+
+  if(update_base && req->erase) {
+    avrdude_message(MSG_INFO, "%s: conflicting -e and --base options specified\n", progname);
+    rc = -1;
+    goto done;
+  }
+
+  // -U operations and chip erase bypass the cache: write it out first, discard it after
+  if(lsize(updates) > 0 || req->erase)
+    pgm->flush_cache(pgm, p);
+
+  // Delta programming needs pages that can be erased one by one
+  if(update_base && lsize(updates) > 0 && update_base_check(pgm, p, &req->flags) < 0) {
+    rc = -1;
+    goto done;
+  }
+
+  if(!req->erase && (req->flags & UF_AUTO_ERASE) && lsize(updates) > 0)
+    req->erase = daemon_auto_erase(pgm, p, updates, &req->flags);
+
+  if(req->erase) {
+    if(req->flags & UF_NOWRITE) {
+      avrdude_message(MSG_INFO, "%s: conflicting -e and -n options specified, NOT erasing chip\n",
+        progname);
+    } else {
+      if(quell_progress < 2)
+        avrdude_message(MSG_INFO, "%s: erasing chip\n", progname);
+      trace_begin("chip erase");
+      rc = avr_chip_erase(pgm, p);
+      trace_end();
+      pgm->reset_cache(pgm, p);
+      if(rc) {
+        failed = 1;
+        goto done;
+      }
+    }
+  }
+
+  if(lsize(updates) > 0) {
+    rc = do_ops(pgm, p, updates, req->flags);
+    pgm->reset_cache(pgm, p);
+    if(rc == LIBAVRDUDE_SOFTFAIL)
+      rc = 0;
+    if(rc) {
+      failed = 1;
+      goto done;
+    }
+  }
+
+  for(LNODEID ln = lfirst(req->lines); ln; ln = lnext(ln))
+    if((rc = terminal_line(pgm, p, ldata(ln))) > 0)
+      break;
+
+  if(pgm->flush_cache(pgm, p) < 0 && rc <= 0)
+    rc = -1;
+
+done:
+  if(failed) {
+    // The part may have been left in any state; start over from scratch
+    avrdude_message(MSG_INFO, "%s: request failed, initialising the part anew\n", progname);
+    pgm->reset_cache(pgm, p);
+    if(pgm->initialize(pgm, p) < 0)
+      avrdude_message(MSG_INFO, "%s: initialization failed\n", progname);
+  }
+  trace_end();
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(savedout, STDOUT_FILENO);
+  dup2(savederr, STDERR_FILENO);
+  close(savedout);
+  close(savederr);
+  if(fchdir(cwd) < 0)
+    avrdude_message(MSG_INFO, "%s: cannot return to working directory: %s\n",
+      progname, strerror(errno));
+  close(cwd);
+
+  verbose = saved_verbose;
+  quell_progress = saved_quell;
+  update_progress = saved_progress;
+  update_base = saved_base;
+  ldestroy_cb(updates, (void (*)(void *)) free_update);
+
+  return rc;
+}
+
+// Serve the requests of one client; returns whether the daemon should stop
+static int daemon_session(PROGRAMMER *pgm, struct avrpart *p, int fd) {
+  daemon_request req;
+  char *line = NULL, status[32];
+  size_t size = 0;
+  ssize_t len;
+  int rc, n, stop = 0;
+  FILE *in;
+
+  if((in = fdopen(dup(fd), "r")) == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot read from client: %s\n", progname, strerror(errno));
+    return 0;
+  }
+
+  daemon_request_init(&req);
+  while(!daemon_stop && (len = getline(&line, &size, in)) >= 0) {
+    while(len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+      line[--len] = 0;
+
+    if(strcmp(line, ".") != 0) {
+      daemon_request_line(&req, line);
+      continue;
+    }
+
+    rc = daemon_run(pgm, p, &req, fd);
+    stop = req.stop;
+    daemon_request_free(&req);
+    daemon_request_init(&req);
+
+    n = snprintf(status, sizeof status, "%c%d\n", DAEMON_STATUS, rc);
+    if(write(fd, status, n) != n || stop)
+      break;
+  }
+
+  daemon_request_free(&req);
+  free(line);
+  fclose(in);
+
+  return stop;
+}
+
+int daemon_serve(PROGRAMMER *pgm, struct avrpart *p, const char *path) {
+  struct sockaddr_un sa;
+  struct sigaction act;
+  struct stat sb;
+  int sock, fd;
+  mode_t mask;
+
+  if(daemon_address(&sa, path) < 0)
+    return -1;
+
+  if((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot create socket: %s\n", progname, strerror(errno));
+    return -1;
+  }
+
+  // Replace a socket left over by a daemon that is no longer running
+  if(stat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) {
+    if(connect(sock, (struct sockaddr *) &sa, sizeof sa) == 0) {
+      avrdude_message(MSG_INFO, "%s: another daemon is already listening on %s\n", progname, path);
+      close(sock);
+      return -1;
+    }
+    unlink(path);
+  }
+
+  // Only the user running the daemon may connect
+  mask = umask(077);
+  if(bind(sock, (struct sockaddr *) &sa, sizeof sa) < 0 || listen(sock, 4) < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot listen on %s: %s\n", progname, path, strerror(errno));
+    umask(mask);
+    close(sock);
+    return -1;
+  }
+  umask(mask);
+
+  // No SA_RESTART so that a signal interrupts accept() and getline()
+  memset(&act, 0, sizeof act);
+  sigemptyset(&act.sa_mask);
+  act.sa_handler = daemon_signal;
+  sigaction(SIGINT, &act, NULL);
+  sigaction(SIGTERM, &act, NULL);
+  act.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &act, NULL);
+
+  if(quell_progress < 2)
+    avrdude_message(MSG_INFO, "%s: daemon listening on %s\n", progname, path);
+
+  daemon_stop = 0;
+  while(!daemon_stop) {
+    if((fd = accept(sock, NULL, NULL)) < 0) {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;
+      avrdude_message(MSG_INFO, "%s: cannot accept connection: %s\n", progname, strerror(errno));
+      break;
+    }
+    if(daemon_session(pgm, p, fd))
+      daemon_stop = 1;
+    close(fd);
+  }
+
+  close(sock);
+  unlink(path);
+  if(quell_progress < 2)
+    avrdude_message(MSG_INFO, "%s: daemon stopped\n", progname);
+
+  return 0;
+}
+
+// Copy the daemon's output to stderr up to the status line, then return the status
+static int daemon_reply(FILE *in) {
+  int c, rc;
+
+  while((c = getc(in)) != EOF && c != DAEMON_STATUS)
+    putc(c, stderr);
+  fflush(stderr);
+
+  if(c == EOF || fscanf(in, "%d", &rc) != 1) {
+    avrdude_message(MSG_INFO, "%s: lost connection to daemon\n", progname);
+    return -1;
+  }
+  while((c = getc(in)) != EOF && c != '\n')
+    continue;
+
+  return rc;
+}
+
+// Send one request and wait for its result
+static int daemon_request_send(FILE *in, FILE *out, const char *dir, enum updateflags flags,
+  int erase, LISTID ops, const char *line, int stop) {
+
+  fprintf(out, "D %s\nF %d %d %d\n", dir, (int) flags, verbose, quell_progress);
+  if(erase)
+    fprintf(out, "E\n");
+  if(update_base && ops)
+    fprintf(out, "B %s\n", update_base);
+  for(LNODEID ln = ops? lfirst(ops): NULL; ln; ln = lnext(ln))
+    fprintf(out, "U %s\n", (char *) ldata(ln));
+  if(line)
+    fprintf(out, "T %s\n", line);
+  if(stop)
+    fprintf(out, "Q\n");
+  fprintf(out, ".\n");
+
+  if(fflush(out) == EOF) {
+    avrdude_message(MSG_INFO, "%s: cannot send request to daemon: %s\n", progname, strerror(errno));
+    return -1;
+  }
+
+  return daemon_reply(in);
+}
+
+int daemon_client(const char *path, LISTID ops, int terminal, enum updateflags flags,
+  int erase, int stop) {
+
+  struct sockaddr_un sa;
+  struct sigaction act;
+  char dir[PATH_MAX], *cmdbuf;
+  FILE *in, *out;
+  int fd, rc = 0;
+
+  if(daemon_address(&sa, path) < 0)
+    return -1;
+
+  if(getcwd(dir, sizeof dir) == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot determine working directory: %s\n", progname, strerror(errno));
+    return -1;
+  }
+
+  for(LNODEID ln = lfirst(ops); ln; ln = lnext(ln))
+    if(strpbrk(ldata(ln), "\r\n")) {
+      avrdude_message(MSG_INFO, "%s: invalid update operation '%s'\n", progname, (char *) ldata(ln));
+      return -1;
+    }
+  if(update_base && strpbrk(update_base, "\r\n")) {
+    avrdude_message(MSG_INFO, "%s: invalid base file name '%s'\n", progname, update_base);
+    return -1;
+  }
+
+  if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+    connect(fd, (struct sockaddr *) &sa, sizeof sa) < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot connect to daemon on %s: %s\n", progname, path, strerror(errno));
+    if(fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  if((in = fdopen(fd, "r")) == NULL || (out = fdopen(dup(fd), "w")) == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot set up connection to daemon: %s\n", progname, strerror(errno));
+    if(in)
+      fclose(in);
+    else
+      close(fd);
+    return -1;
+  }
+
+  memset(&act, 0, sizeof act);
+  sigemptyset(&act.sa_mask);
+  act.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &act, NULL);
+
+  // Same order as a local session: chip erase, terminal, then -U operations
+  if(erase && terminal) {
+    rc = daemon_request_send(in, out, dir, flags, 1, NULL, NULL, 0);
+    erase = 0;
+  }
+
+  while(terminal && rc >= 0 && (cmdbuf = terminal_get_input("avrdude> ")) != NULL) {
+    cmdbuf[strcspn(cmdbuf, "\r\n")] = 0;
+    rc = daemon_request_send(in, out, dir, flags, 0, NULL, cmdbuf, 0);
+    free(cmdbuf);
+    if(rc > 0) {
+      rc = 0;
+      break;
+    }
+    if(rc < 0 && feof(in))
+      break;
+    rc = 0;
+  }
+
+  if(rc >= 0 && (erase || lsize(ops) > 0 || stop))
+    rc = daemon_request_send(in, out, dir, flags, erase, ops, NULL, stop);
+
+  fclose(out);
+  fclose(in);
+
+  return rc;
+}
+
+#endif
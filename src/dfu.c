@@ -85,6 +85,8 @@ int dfu_upload(struct dfu_dev *dfu, void * ptr, int size) {
 #define DFU_GETSTATE 5          /* FLIPv1 only; not used */
 #define DFU_ABORT 6             /* FLIPv1 only */
 
+#define DFU_FUNCTIONAL_DESCRIPTOR 0x21
+
 /* Block counter global variable. Incremented each time a DFU_DNLOAD command
  * is sent to the device.
  */
@@ -95,6 +97,7 @@ static uint16_t wIndex = 0;
  */
 
 static char * get_usb_string(usb_dev_handle * dev_handle, int index);
+static unsigned short get_xfer_size(const unsigned char *extra, int extralen);
 
 /* EXPORTED FUNCTION DEFINITIONS
  */
@@ -239,6 +242,20 @@ int dfu_init(struct dfu_dev *dfu, unsigned short vid, unsigned short pid)
       memcpy(&dfu->endp_desc, found->config->interface->altsetting->endpoint,
              sizeof(dfu->endp_desc));
 
+  /* The DFU functional descriptor follows the interface descriptor, though
+   * some devices put it after the configuration descriptor.
+   */
+
+  dfu->xfer_size = get_xfer_size(found->config->interface->altsetting->extra,
+    found->config->interface->altsetting->extralen);
+  if (dfu->xfer_size == 0)
+    dfu->xfer_size = get_xfer_size(found->config->extra,
+      found->config->extralen);
+
+  if (dfu->xfer_size != 0)
+    avrdude_message(MSG_NOTICE, "%s: DFU transfer size %hu\n",
+      progname, dfu->xfer_size);
+
   /* Get strings. */
 
   dfu->manf_str = get_usb_string(dfu->dev_handle,
@@ -255,6 +272,9 @@ int dfu_init(struct dfu_dev *dfu, unsigned short vid, unsigned short pid)
 
 void dfu_close(struct dfu_dev *dfu)
 {
+  avrdude_message(MSG_NOTICE2, "%s: %lu DFU control transfers\n",
+    progname, dfu->ctrl_xfers);
+
   if (dfu->dev_handle != NULL)
     usb_close(dfu->dev_handle);
   if (dfu->bus_name != NULL)
@@ -274,6 +294,7 @@ int dfu_getstatus(struct dfu_dev *dfu, struct dfu_status *status)
   avrdude_message(MSG_TRACE, "%s: dfu_getstatus(): issuing control IN message\n",
             progname);
 
+  dfu->ctrl_xfers++;
   result = usb_control_msg(dfu->dev_handle,
     0x80 | USB_TYPE_CLASS | USB_RECIP_INTERFACE, DFU_GETSTATUS, 0, 0,
     (char*) status, sizeof(struct dfu_status), dfu->timeout);
@@ -313,6 +334,7 @@ int dfu_clrstatus(struct dfu_dev *dfu)
   avrdude_message(MSG_TRACE, "%s: dfu_clrstatus(): issuing control OUT message\n",
                   progname);
 
+  dfu->ctrl_xfers++;
   result = usb_control_msg(dfu->dev_handle,
     USB_TYPE_CLASS | USB_RECIP_INTERFACE, DFU_CLRSTATUS, 0, 0,
     NULL, 0, dfu->timeout);
@@ -333,6 +355,7 @@ int dfu_abort(struct dfu_dev *dfu)
   avrdude_message(MSG_TRACE, "%s: dfu_abort(): issuing control OUT message\n",
                   progname);
 
+  dfu->ctrl_xfers++;
   result = usb_control_msg(dfu->dev_handle,
     USB_TYPE_CLASS | USB_RECIP_INTERFACE, DFU_ABORT, 0, 0,
     NULL, 0, dfu->timeout);
@@ -354,6 +377,7 @@ int dfu_dnload(struct dfu_dev *dfu, void *ptr, int size)
   avrdude_message(MSG_TRACE, "%s: dfu_dnload(): issuing control OUT message, wIndex = %d, ptr = %p, size = %d\n",
                   progname, wIndex, ptr, size);
 
+  dfu->ctrl_xfers++;
   result = usb_control_msg(dfu->dev_handle,
     USB_TYPE_CLASS | USB_RECIP_INTERFACE, DFU_DNLOAD, wIndex++, 0,
     ptr, size, dfu->timeout);
@@ -386,6 +410,7 @@ int dfu_upload(struct dfu_dev *dfu, void *ptr, int size)
   avrdude_message(MSG_TRACE, "%s: dfu_upload(): issuing control IN message, wIndex = %d, ptr = %p, size = %d\n",
                   progname, wIndex, ptr, size);
 
+  dfu->ctrl_xfers++;
   result = usb_control_msg(dfu->dev_handle,
     0x80 | USB_TYPE_CLASS | USB_RECIP_INTERFACE, DFU_UPLOAD, wIndex++, 0,
     ptr, size, dfu->timeout);
@@ -467,6 +492,20 @@ char * get_usb_string(usb_dev_handle * dev_handle, int index) {
   return str;
 }
 
+/* Return wTransferSize from the DFU functional descriptor among the extra
+ * descriptors, or 0 if there is none.
+ */
+unsigned short get_xfer_size(const unsigned char *extra, int extralen) {
+  while (extra != NULL && extralen >= 2 && extra[0] >= 2 && extra[0] <= extralen) {
+    if (extra[1] == DFU_FUNCTIONAL_DESCRIPTOR && extra[0] >= 7)
+      return extra[5] | (extra[6] << 8);
+    extralen -= extra[0];
+    extra += extra[0];
+  }
+
+  return 0;
+}
+
 #endif /* defined(HAVE_LIBUSB) */
 
 /* EXPORTED FUNCTIONS THAT DO NO REQUIRE LIBUSB
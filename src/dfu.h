@@ -56,6 +56,8 @@ struct dfu_dev
   struct usb_endpoint_descriptor endp_desc;
   char *manf_str, *prod_str, *serno_str;
   unsigned int timeout;
+  unsigned short xfer_size;     /* wTransferSize, 0 if not reported */
+  unsigned long ctrl_xfers;     /* control transfers issued */
 };
 
 #else
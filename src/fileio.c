@@ -27,6 +27,8 @@
 #include <errno.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_LIBELF
 #ifdef HAVE_LIBELF_H
@@ -829,49 +831,70 @@ static int elf_mem_limits(AVRMEM *mem, struct avrpart * p,
 }
 
 
-static int elf2b(char * infile, FILE * inf,
-                 AVRMEM * mem, struct avrpart * p,
-                 int bufsize, unsigned int fileoffset)
+/*
+ * An ELF file is parsed once per session: the data of all loadable
+ * sections are kept with their load addresses, and each memory that
+ * is later read from the same file (flash, eeprom, fuses, lock) is
+ * filled from this image rather than opening and walking the file
+ * again.  The image is reloaded if the file changes.
+ */
+typedef struct {
+  char name[32];                /* Section name for messages */
+  unsigned int lma, size;
+  unsigned char *data;
+} elf_section;
+
+static struct {
+  char *filename;
+  int awire;                    /* Image was checked for an AVR32 part */
+  struct stat st;
+  int nsections;
+  elf_section *sections;
+} elf_image;
+
+static void elf_image_free(void)
+{
+  for (int i = 0; i < elf_image.nsections; i++)
+    free(elf_image.sections[i].data);
+  free(elf_image.sections);
+  free(elf_image.filename);
+  memset(&elf_image, 0, sizeof elf_image);
+}
+
+/*
+ * Check the ELF file and load all its PT_LOAD sections with file
+ * data into elf_image; return 0 on success and -1 on error
+ */
+static int elf_load(char * infile, FILE * inf, struct avrpart * p)
 {
   Elf *e;
   int rv = -1;
-  unsigned int low, high, foff;
-
-  if (elf_mem_limits(mem, p, &low, &high, &foff) != 0) {
-    avrdude_message(MSG_INFO, "%s: ERROR: Cannot handle \"%s\" memory region from ELF file\n",
-                    progname, mem->desc);
-    return -1;
+  struct stat st;
+
+  if (elf_image.filename && strcmp(infile, "<stdin>") != 0 &&
+      strcmp(elf_image.filename, infile) == 0 &&
+      elf_image.awire == !!(p->prog_modes & PM_aWire) &&
+      fstat(fileno(inf), &st) == 0 &&
+      st.st_size == elf_image.st.st_size && st.st_mtime == elf_image.st.st_mtime &&
+      st.st_ino == elf_image.st.st_ino && st.st_dev == elf_image.st.st_dev) {
+    avrdude_message(MSG_NOTICE2, "%s: using already parsed ELF file \"%s\"\n",
+                    progname, infile);
+    return 0;
   }
 
-  /*
-   * The Xmega memory regions for "boot", "application", and
-   * "apptable" are actually sub-regions of "flash".  Refine the
-   * applicable limits.  This allows to select only the appropriate
-   * sections out of an ELF file that contains section data for more
-   * than one sub-segment.
-   */
-  if ((p->prog_modes & PM_PDI) != 0 &&
-      (strcmp(mem->desc, "boot") == 0 ||
-       strcmp(mem->desc, "application") == 0 ||
-       strcmp(mem->desc, "apptable") == 0)) {
-    AVRMEM *flashmem = avr_locate_mem(p, "flash");
-    if (flashmem == NULL) {
-      avrdude_message(MSG_INFO, "%s: ERROR: No \"flash\" memory region found, "
-                      "cannot compute bounds of \"%s\" sub-region.\n",
-                      progname, mem->desc);
-      return -1;
-    }
-    /* The config file offsets are PDI offsets, rebase to 0. */
-    low = mem->offset - flashmem->offset;
-    high = low + mem->size - 1;
-  }
+  elf_image_free();
 
   if (elf_version(EV_CURRENT) == EV_NONE) {
     avrdude_message(MSG_INFO, "%s: ERROR: ELF library initialization failed: %s\n",
                     progname, elf_errmsg(-1));
     return -1;
   }
-  if ((e = elf_begin(fileno(inf), ELF_C_READ, NULL)) == NULL) {
+#ifdef ELF_C_READ_MMAP
+  e = elf_begin(fileno(inf), ELF_C_READ_MMAP, NULL);
+#else
+  e = elf_begin(fileno(inf), ELF_C_READ, NULL);
+#endif
+  if (e == NULL) {
     avrdude_message(MSG_INFO, "%s: ERROR: Cannot open \"%s\" as an ELF file: %s\n",
                     progname, infile, elf_errmsg(-1));
     return -1;
@@ -956,6 +979,8 @@ static int elf2b(char * infile, FILE * inf,
     sndx = 0;
   }
 
+  elf_image.sections = cfg_malloc("elf_load()", (eh->e_phnum + 1) * sizeof *elf_image.sections);
+
   /*
    * Walk the program header table, pick up entries that are of type
    * PT_LOAD, and have a non-zero p_filesz.
@@ -967,7 +992,7 @@ static int elf2b(char * infile, FILE * inf,
 
     avrdude_message(MSG_NOTICE2, "%s: Considering PT_LOAD program header entry #%d:\n"
                     "    p_vaddr 0x%x, p_paddr 0x%x, p_filesz %d\n",
-                    progname, i, ph[i].p_vaddr, ph[i].p_paddr, ph[i].p_filesz);
+                    progname, (int) i, ph[i].p_vaddr, ph[i].p_paddr, ph[i].p_filesz);
 
     Elf32_Shdr *sh;
     Elf_Scn *s = elf_get_scn(e, ph + i, &sh);
@@ -975,6 +1000,7 @@ static int elf2b(char * infile, FILE * inf,
       continue;
 
     if ((sh->sh_flags & SHF_ALLOC) && sh->sh_size) {
+      elf_section *es = elf_image.sections + elf_image.nsections;
       const char *sname;
 
       if (sndx != 0) {
@@ -983,72 +1009,159 @@ static int elf2b(char * infile, FILE * inf,
         sname = "*unknown*";
       }
 
-      unsigned int lma;
-      lma = ph[i].p_paddr + sh->sh_offset - ph[i].p_offset;
+      es->lma = ph[i].p_paddr + sh->sh_offset - ph[i].p_offset;
+      es->size = sh->sh_size;
+      es->data = cfg_malloc("elf_load()", sh->sh_size);
+      strncpy(es->name, sname? sname: "*unknown*", sizeof es->name - 1);
 
       avrdude_message(MSG_NOTICE2, "%s: Found section \"%s\", LMA 0x%x, sh_size %u\n",
-                      progname, sname, lma, sh->sh_size);
-
-      if (lma >= low &&
-          lma + sh->sh_size < high) {
-        /* OK */
-      } else {
-        avrdude_message(MSG_NOTICE2, "    => skipping, inappropriate for \"%s\" memory region\n",
-                        mem->desc);
-        continue;
-      }
-      /*
-       * 1-byte sized memory regions are special: they are used for fuse
-       * bits, where multiple regions (in the config file) map to a
-       * single, larger region in the ELF file (e.g. "lfuse", "hfuse",
-       * and "efuse" all map to ".fuse").  We silently accept a larger
-       * ELF file region for these, and extract the actual byte to write
-       * from it, using the "foff" offset obtained above.
-       */
-      if (mem->size != 1 && sh->sh_size > (unsigned) mem->size) {
-        avrdude_message(MSG_INFO, "%s: ERROR: section \"%s\" does not fit into \"%s\" memory:\n"
-                        "    0x%x + %u > %u\n",
-                        progname, sname, mem->desc,
-                        lma, sh->sh_size, mem->size);
-        continue;
-      }
+                      progname, es->name, es->lma, es->size);
 
       Elf_Data *d = NULL;
       while ((d = elf_getdata(s, d)) != NULL) {
         avrdude_message(MSG_NOTICE2, "    Data block: d_buf %p, d_off 0x%x, d_size %d\n",
-                        d->d_buf, (unsigned int)d->d_off, d->d_size);
-        if (mem->size == 1) {
-          if (d->d_off != 0) {
-            avrdude_message(MSG_INFO, "%s: ERROR: unexpected data block at offset != 0\n",
-                            progname);
-          } else if (foff >= d->d_size) {
-            avrdude_message(MSG_INFO, "%s: ERROR: ELF file section does not contain byte at offset %d\n",
-                            progname, foff);
-          } else {
-            avrdude_message(MSG_NOTICE2, "    Extracting one byte from file offset %d\n",
-                            foff);
-            mem->buf[0] = ((unsigned char *)d->d_buf)[foff];
-            mem->tags[0] = TAG_ALLOCATED;
-            rv = 1;
-          }
-        } else {
-          unsigned int idx;
-
-          idx = lma - low + d->d_off;
-          if ((int)(idx + d->d_size) > rv)
-            rv = idx + d->d_size;
-          avrdude_message(MSG_DEBUG, "    Writing %d bytes to mem offset 0x%x\n",
-                          d->d_size, idx);
-          memcpy(mem->buf + idx, d->d_buf, d->d_size);
-          memset(mem->tags + idx, TAG_ALLOCATED, d->d_size);
-        }
+                        d->d_buf, (unsigned int)d->d_off, (int) d->d_size);
+        if (d->d_buf && d->d_off + d->d_size <= es->size)
+          memcpy(es->data + d->d_off, d->d_buf, d->d_size);
       }
+      elf_image.nsections++;
     }
   }
+
+  elf_image.filename = cfg_strdup("elf_load()", infile);
+  elf_image.awire = !!(p->prog_modes & PM_aWire);
+  if (fstat(fileno(inf), &elf_image.st) != 0)
+    memset(&elf_image.st, 0, sizeof elf_image.st);
+  rv = 0;
+
 done:
   (void)elf_end(e);
+  if (rv < 0)
+    elf_image_free();
   return rv;
 }
+
+static int elf_region(AVRMEM * mem, struct avrpart * p,
+                      unsigned int *low, unsigned int *high,
+                      unsigned int *foff)
+{
+  if (elf_mem_limits(mem, p, low, high, foff) != 0)
+    return -1;
+
+  /*
+   * The Xmega memory regions for "boot", "application", and
+   * "apptable" are actually sub-regions of "flash".  Refine the
+   * applicable limits.  This allows to select only the appropriate
+   * sections out of an ELF file that contains section data for more
+   * than one sub-segment.
+   */
+  if ((p->prog_modes & PM_PDI) != 0 &&
+      (strcmp(mem->desc, "boot") == 0 ||
+       strcmp(mem->desc, "application") == 0 ||
+       strcmp(mem->desc, "apptable") == 0)) {
+    AVRMEM *flashmem = avr_locate_mem(p, "flash");
+    if (flashmem == NULL) {
+      avrdude_message(MSG_INFO, "%s: ERROR: No \"flash\" memory region found, "
+                      "cannot compute bounds of \"%s\" sub-region.\n",
+                      progname, mem->desc);
+      return -1;
+    }
+    /* The config file offsets are PDI offsets, rebase to 0. */
+    *low = mem->offset - flashmem->offset;
+    *high = *low + mem->size - 1;
+  }
+
+  return 0;
+}
+
+static int elf2b(char * infile, FILE * inf,
+                 AVRMEM * mem, struct avrpart * p,
+                 int bufsize, unsigned int fileoffset)
+{
+  int i, rv = -1;
+  unsigned int low, high, foff;
+
+  if (elf_region(mem, p, &low, &high, &foff) != 0) {
+    avrdude_message(MSG_INFO, "%s: ERROR: Cannot handle \"%s\" memory region from ELF file\n",
+                    progname, mem->desc);
+    return -1;
+  }
+
+  if (elf_load(infile, inf, p) < 0)
+    return -1;
+
+  for (i = 0; i < elf_image.nsections; i++) {
+    elf_section *es = elf_image.sections + i;
+
+    if (es->lma >= low &&
+        es->lma + es->size < high) {
+      /* OK */
+    } else {
+      avrdude_message(MSG_NOTICE2, "%s: Section \"%s\" => skipping, inappropriate for \"%s\" memory region\n",
+                      progname, es->name, mem->desc);
+      continue;
+    }
+    /*
+     * 1-byte sized memory regions are special: they are used for fuse
+     * bits, where multiple regions (in the config file) map to a
+     * single, larger region in the ELF file (e.g. "lfuse", "hfuse",
+     * and "efuse" all map to ".fuse").  We silently accept a larger
+     * ELF file region for these, and extract the actual byte to write
+     * from it, using the "foff" offset obtained above.
+     */
+    if (mem->size != 1 && es->size > (unsigned) mem->size) {
+      avrdude_message(MSG_INFO, "%s: ERROR: section \"%s\" does not fit into \"%s\" memory:\n"
+                      "    0x%x + %u > %u\n",
+                      progname, es->name, mem->desc,
+                      es->lma, es->size, mem->size);
+      continue;
+    }
+
+    if (mem->size == 1) {
+      if (foff >= es->size) {
+        avrdude_message(MSG_INFO, "%s: ERROR: ELF file section does not contain byte at offset %d\n",
+                        progname, foff);
+      } else {
+        avrdude_message(MSG_NOTICE2, "    Extracting one byte from file offset %d\n",
+                        foff);
+        mem->buf[0] = es->data[foff];
+        mem->tags[0] = TAG_ALLOCATED;
+        rv = 1;
+      }
+    } else {
+      unsigned int idx;
+
+      idx = es->lma - low;
+      if ((int)(idx + es->size) > rv)
+        rv = idx + es->size;
+      avrdude_message(MSG_DEBUG, "    Writing %d bytes to mem offset 0x%x\n",
+                      es->size, idx);
+      memcpy(mem->buf + idx, es->data, es->size);
+      memset(mem->tags + idx, TAG_ALLOCATED, es->size);
+    }
+  }
+
+  return rv;
+}
+
+// Does the ELF file hold data for the memory?
+static int elf_has_mem(AVRMEM * mem, struct avrpart * p)
+{
+  unsigned int low, high, foff;
+
+  if (elf_region(mem, p, &low, &high, &foff) != 0)
+    return 0;
+
+  for (int i = 0; i < elf_image.nsections; i++) {
+    elf_section *es = elf_image.sections + i;
+
+    if (es->lma >= low && es->lma + es->size < high &&
+        (mem->size == 1? foff < es->size: es->size <= (unsigned) mem->size))
+      return 1;
+  }
+
+  return 0;
+}
 #endif  /* HAVE_LIBELF */
 
 /*
@@ -1632,3 +1745,36 @@ int fileio(int oprwv, char * filename, FILEFMT format,
   return rc;
 }
 
+
+
+/*
+ * Return whether the ELF file holds data for memory memtype of part p
+ * (1: yes, 0: no, -1: error); the file is parsed only once for all
+ * memories and subsequent fileio() reads
+ */
+int fileio_elf_has_mem(char * filename, struct avrpart * p, char * memtype)
+{
+#ifdef HAVE_LIBELF
+  AVRMEM *mem;
+  FILE *f;
+  int rc;
+
+  if ((mem = avr_locate_mem(p, memtype)) == NULL)
+    return 0;
+
+  if ((f = fopen(filename, "rb")) == NULL) {
+    avrdude_message(MSG_INFO, "%s: can't open input file %s: %s\n",
+            progname, filename, strerror(errno));
+    return -1;
+  }
+  rc = elf_load(filename, f, p);
+  fclose(f);
+
+  return rc < 0? -1: elf_has_mem(mem, p);
+#else
+  avrdude_message(MSG_INFO, "%s: can't handle ELF file %s, "
+                  "ELF file support was not compiled in\n",
+                  progname, filename);
+  return -1;
+#endif
+}
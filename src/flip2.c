@@ -60,6 +60,13 @@ struct flip2
   unsigned char part_sig[3];
   unsigned char part_rev;
   unsigned char boot_ver;
+
+  /* Memory unit and page currently selected in the bootloader, or -1 if
+   * unknown. Selections persist across commands, so they are only sent when
+   * they change.
+   */
+  int mem_unit;
+  int page_addr;
 };
 
 #define FLIP2(pgm) ((struct flip2 *)(pgm->cookie))
@@ -100,6 +107,12 @@ struct flip2_cmd {
 #define FLIP2_SELECT_MEMORY_UNIT 0x00
 #define FLIP2_SELECT_MEMORY_PAGE 0x01
 
+/* Largest data block per read or write command if the device does not
+ * report wTransferSize in its DFU functional descriptor.
+ */
+#define FLIP2_DEFAULT_XFER_SIZE 0x400
+#define FLIP2_MAX_XFER_SIZE 0x8000
+
 enum flip2_mem_unit {
   FLIP2_MEM_UNIT_UNKNOWN = -1,
   FLIP2_MEM_UNIT_FLASH = 0x00,
@@ -151,17 +164,20 @@ static void flip2_teardown(PROGRAMMER * pgm);
 
 static void flip2_show_info(struct flip2 *flip2);
 
-static int flip2_read_memory(struct dfu_dev *dfu,
+static int flip2_read_memory(struct flip2 *flip2,
   enum flip2_mem_unit mem_unit, uint32_t addr, void *ptr, int size);
-static int flip2_write_memory(struct dfu_dev *dfu,
+static int flip2_write_memory(struct flip2 *flip2,
   enum flip2_mem_unit mem_unit, uint32_t addr, const void *ptr, int size);
 
+static int flip2_select(struct flip2 *flip2,
+  enum flip2_mem_unit mem_unit, unsigned short page_addr);
 static int flip2_set_mem_unit(struct dfu_dev *dfu,
   enum flip2_mem_unit mem_unit);
 static int flip2_set_mem_page(struct dfu_dev *dfu, unsigned short page_addr);
-static int flip2_read_max1k(struct dfu_dev *dfu,
+static int flip2_xfer_size(struct dfu_dev *dfu);
+static int flip2_read_block(struct dfu_dev *dfu,
   unsigned short offset, void *ptr, unsigned short size);
-static int flip2_write_max1k(struct dfu_dev *dfu,
+static int flip2_write_block(struct dfu_dev *dfu,
   unsigned short offset, const void *ptr, unsigned short size);
 
 static const char * flip2_status_str(const struct dfu_status *status);
@@ -245,6 +261,9 @@ int flip2_initialize(const PROGRAMMER *pgm, const AVRPART *part) {
   if (result != 0)
     goto flip2_initialize_fail;
 
+  FLIP2(pgm)->mem_unit = -1;
+  FLIP2(pgm)->page_addr = -1;
+
   /* Check if descriptor values are what we expect. */
 
   if (dfu->dev_desc.idVendor != vid)
@@ -287,13 +306,13 @@ int flip2_initialize(const PROGRAMMER *pgm, const AVRPART *part) {
     avrdude_message(MSG_INFO, "%s: Warning: USB bInterfaceSubClass = %d (expected 0)\n",
       progname, (int) dfu->intf_desc.bInterfaceProtocol);
 
-  result = flip2_read_memory(FLIP2(pgm)->dfu,
+  result = flip2_read_memory(FLIP2(pgm),
     FLIP2_MEM_UNIT_SIGNATURE, 0, FLIP2(pgm)->part_sig, 4);
 
   if (result != 0)
     goto flip2_initialize_fail;
 
-  result = flip2_read_memory(FLIP2(pgm)->dfu,
+  result = flip2_read_memory(FLIP2(pgm),
     FLIP2_MEM_UNIT_BOOTLOADER, 0, &FLIP2(pgm)->boot_ver, 1);
 
   if (result != 0)
@@ -349,6 +368,9 @@ int flip2_chip_erase(const PROGRAMMER *pgm, const AVRPART *part) {
 
   avrdude_message(MSG_NOTICE2, "%s: flip_chip_erase()\n", progname);
 
+  FLIP2(pgm)->mem_unit = -1;
+  FLIP2(pgm)->page_addr = -1;
+
   struct flip2_cmd cmd = {
     FLIP2_CMD_GROUP_EXEC, FLIP2_CMD_CHIP_ERASE, { 0xFF, 0, 0, 0 }
   };
@@ -412,7 +434,7 @@ int flip2_read_byte(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *me
     return -1;
   }
 
-  return flip2_read_memory(FLIP2(pgm)->dfu, mem_unit, addr, value, 1);
+  return flip2_read_memory(FLIP2(pgm), mem_unit, addr, value, 1);
 }
 
 int flip2_write_byte(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *mem,
@@ -435,7 +457,7 @@ int flip2_write_byte(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *m
     return -1;
   }
 
-  return flip2_write_memory(FLIP2(pgm)->dfu, mem_unit, addr, &value, 1);
+  return flip2_write_memory(FLIP2(pgm), mem_unit, addr, &value, 1);
 }
 
 int flip2_paged_load(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *mem,
@@ -466,7 +488,7 @@ int flip2_paged_load(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *m
     exit(1);
   }
 
-  result = flip2_read_memory(FLIP2(pgm)->dfu, mem_unit, addr,
+  result = flip2_read_memory(FLIP2(pgm), mem_unit, addr,
     mem->buf + addr, n_bytes);
 
   return (result == 0) ? n_bytes : -1;
@@ -500,7 +522,7 @@ int flip2_paged_write(const PROGRAMMER *pgm, const AVRPART *part, const AVRMEM *
     exit(1);
   }
 
-  result = flip2_write_memory(FLIP2(pgm)->dfu, mem_unit, addr,
+  result = flip2_write_memory(FLIP2(pgm), mem_unit, addr,
     mem->buf + addr, n_bytes);
 
   return (result == 0) ? n_bytes : -1;
@@ -588,58 +610,32 @@ void flip2_show_info(struct flip2 *flip2)
     (unsigned short) flip2->dfu->dev_desc.bMaxPacketSize0);
 }
 
-int flip2_read_memory(struct dfu_dev *dfu,
+int flip2_read_memory(struct flip2 *flip2,
   enum flip2_mem_unit mem_unit, uint32_t addr, void *ptr, int size)
 {
-  unsigned short prev_page_addr;
-  unsigned short page_addr;
-  const char * mem_name;
+  int xfer_size = flip2_xfer_size(flip2->dfu);
   int read_size;
   int result;
 
   avrdude_message(MSG_NOTICE2, "%s: flip_read_memory(%s, 0x%04x, %d)\n",
                   progname, flip2_mem_unit_str(mem_unit), addr, size);
 
-  result = flip2_set_mem_unit(dfu, mem_unit);
-
-  if (result != 0) {
-    if ((mem_name = flip2_mem_unit_str(mem_unit)) != NULL)
-      avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X (%s)\n",
-        progname, (int) mem_unit, mem_name);
-    else
-      avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X\n",
-        progname, (int) mem_unit);
-    return -1;
-  }
-
-  page_addr = addr >> 16;
-  result = flip2_set_mem_page(dfu, page_addr);
-
-  if (result != 0) {
-    avrdude_message(MSG_INFO, "%s: Error: Failed to set memory page 0x%04hX\n",
-        progname, page_addr);
-    return -1;
-  }
-
   while (size > 0) {
-    prev_page_addr = page_addr;
-    page_addr = addr >> 16;
-
-    if (page_addr != prev_page_addr) {
-      result = flip2_set_mem_page(dfu, page_addr);
-      if (result != 0) {
-        avrdude_message(MSG_INFO, "%s: Error: Failed to set memory page 0x%04hX\n",
-            progname, page_addr);
-        return -1;
-      }
-    }
+    if (flip2_select(flip2, mem_unit, addr >> 16) != 0)
+      return -1;
+
+    /* A block must not cross a 64 KiB page boundary. */
+    read_size = (size > xfer_size) ? xfer_size : size;
+    if ((addr & 0xFFFF) + read_size > 0x10000)
+      read_size = 0x10000 - (addr & 0xFFFF);
 
-    read_size = (size > 0x400) ? 0x400 : size;
-    result = flip2_read_max1k(dfu, addr & 0xFFFF, ptr, read_size);
+    result = flip2_read_block(flip2->dfu, addr & 0xFFFF, ptr, read_size);
 
     if (result != 0) {
       avrdude_message(MSG_INFO, "%s: Error: Failed to read 0x%04X bytes at 0x%04lX\n",
           progname, read_size, (unsigned long) addr);
+      flip2->mem_unit = -1;
+      flip2->page_addr = -1;
       return -1;
     }
 
@@ -651,58 +647,32 @@ int flip2_read_memory(struct dfu_dev *dfu,
   return 0;
 }
 
-int flip2_write_memory(struct dfu_dev *dfu,
+int flip2_write_memory(struct flip2 *flip2,
   enum flip2_mem_unit mem_unit, uint32_t addr, const void *ptr, int size)
 {
-  unsigned short prev_page_addr;
-  unsigned short page_addr;
-  const char * mem_name;
+  int xfer_size = flip2_xfer_size(flip2->dfu);
   int write_size;
   int result;
 
   avrdude_message(MSG_NOTICE2, "%s: flip_write_memory(%s, 0x%04x, %d)\n",
                   progname, flip2_mem_unit_str(mem_unit), addr, size);
 
-  result = flip2_set_mem_unit(dfu, mem_unit);
-
-  if (result != 0) {
-    if ((mem_name = flip2_mem_unit_str(mem_unit)) != NULL)
-      avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X (%s)\n",
-        progname, (int) mem_unit, mem_name);
-    else
-      avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X\n",
-        progname, (int) mem_unit);
-    return -1;
-  }
-
-  page_addr = addr >> 16;
-  result = flip2_set_mem_page(dfu, page_addr);
-
-  if (result != 0) {
-    avrdude_message(MSG_INFO, "%s: Error: Failed to set memory page 0x%04hX\n",
-        progname, page_addr);
-    return -1;
-  }
-
   while (size > 0) {
-    prev_page_addr = page_addr;
-    page_addr = addr >> 16;
-
-    if (page_addr != prev_page_addr) {
-      result = flip2_set_mem_page(dfu, page_addr);
-      if (result != 0) {
-        avrdude_message(MSG_INFO, "%s: Error: Failed to set memory page 0x%04hX\n",
-            progname, page_addr);
-        return -1;
-      }
-    }
+    if (flip2_select(flip2, mem_unit, addr >> 16) != 0)
+      return -1;
 
-    write_size = (size > 0x800) ? 0x800 : size;
-    result = flip2_write_max1k(dfu, addr & 0xFFFF, ptr, write_size);
+    /* A block must not cross a 64 KiB page boundary. */
+    write_size = (size > xfer_size) ? xfer_size : size;
+    if ((addr & 0xFFFF) + write_size > 0x10000)
+      write_size = 0x10000 - (addr & 0xFFFF);
+
+    result = flip2_write_block(flip2->dfu, addr & 0xFFFF, ptr, write_size);
 
     if (result != 0) {
       avrdude_message(MSG_INFO, "%s: Error: Failed to write 0x%04X bytes at 0x%04lX\n",
           progname, write_size, (unsigned long) addr);
+      flip2->mem_unit = -1;
+      flip2->page_addr = -1;
       return -1;
     }
 
@@ -714,6 +684,43 @@ int flip2_write_memory(struct dfu_dev *dfu,
   return 0;
 }
 
+/* Select memory unit and page, skipping the DNLOAD/GETSTATUS round trips
+ * for whatever the bootloader has selected already.
+ */
+int flip2_select(struct flip2 *flip2,
+  enum flip2_mem_unit mem_unit, unsigned short page_addr)
+{
+  const char * mem_name;
+
+  if (flip2->mem_unit != mem_unit) {
+    flip2->page_addr = -1;
+
+    if (flip2_set_mem_unit(flip2->dfu, mem_unit) != 0) {
+      if ((mem_name = flip2_mem_unit_str(mem_unit)) != NULL)
+        avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X (%s)\n",
+          progname, (int) mem_unit, mem_name);
+      else
+        avrdude_message(MSG_INFO, "%s: Error: Failed to set memory unit 0x%02X\n",
+          progname, (int) mem_unit);
+      flip2->mem_unit = -1;
+      return -1;
+    }
+    flip2->mem_unit = mem_unit;
+  }
+
+  if (flip2->page_addr != page_addr) {
+    if (flip2_set_mem_page(flip2->dfu, page_addr) != 0) {
+      avrdude_message(MSG_INFO, "%s: Error: Failed to set memory page 0x%04hX\n",
+          progname, page_addr);
+      flip2->page_addr = -1;
+      return -1;
+    }
+    flip2->page_addr = page_addr;
+  }
+
+  return 0;
+}
+
 int flip2_set_mem_unit(struct dfu_dev *dfu, enum flip2_mem_unit mem_unit)
 {
   struct dfu_status status;
@@ -786,7 +793,21 @@ int flip2_set_mem_page(struct dfu_dev *dfu,
   return cmd_result;
 }
 
-int flip2_read_max1k(struct dfu_dev *dfu,
+/* Data bytes per read or write command: the wTransferSize reported by the
+ * device, less the two packets of command header and alignment padding that
+ * a write needs (see flip2_write_block()).
+ */
+int flip2_xfer_size(struct dfu_dev *dfu)
+{
+  int xfer_size = dfu->xfer_size - 2 * dfu->dev_desc.bMaxPacketSize0;
+
+  if (dfu->xfer_size == 0 || xfer_size < dfu->dev_desc.bMaxPacketSize0)
+    return FLIP2_DEFAULT_XFER_SIZE;
+
+  return (xfer_size > FLIP2_MAX_XFER_SIZE) ? FLIP2_MAX_XFER_SIZE : xfer_size;
+}
+
+int flip2_read_block(struct dfu_dev *dfu,
   unsigned short offset, void *ptr, unsigned short size)
 {
   struct dfu_status status;
@@ -805,11 +826,17 @@ int flip2_read_max1k(struct dfu_dev *dfu,
   cmd_result = dfu_dnload(dfu, &cmd, sizeof(cmd));
 
   if (cmd_result != 0)
-    goto flip2_read_max1k_status;
+    goto flip2_read_block_status;
 
   cmd_result = dfu_upload(dfu, (char*) ptr, size);
 
-flip2_read_max1k_status:
+  /* The bootloader stalls the upload if the read command failed, so the
+   * status only needs to be fetched when something went wrong.
+   */
+  if (cmd_result == 0)
+    return 0;
+
+flip2_read_block_status:
 
   aux_result = dfu_getstatus(dfu, &status);
 
@@ -831,10 +858,10 @@ flip2_read_max1k_status:
   return cmd_result;
 }
 
-int flip2_write_max1k(struct dfu_dev *dfu,
+int flip2_write_block(struct dfu_dev *dfu,
   unsigned short offset, const void *ptr, unsigned short size)
 {
-  char buffer[64+64+0x400];
+  char *buffer;
   unsigned short data_offset;
   struct dfu_status status;
   int cmd_result = 0;
@@ -849,9 +876,9 @@ int flip2_write_max1k(struct dfu_dev *dfu,
   cmd.args[2] = ((offset+size-1) >> 8) & 0xFF;
   cmd.args[3] = ((offset+size-1) >> 0) & 0xFF;
 
-  if (size > 0x400) {
-    avrdude_message(MSG_INFO, "%s: Error: Write block too large (%hu > 1024)\n",
-      progname, size);
+  if (size > flip2_xfer_size(dfu)) {
+    avrdude_message(MSG_INFO, "%s: Error: Write block too large (%hu > %d)\n",
+      progname, size, flip2_xfer_size(dfu));
     return -1;
   }
 
@@ -866,11 +893,18 @@ int flip2_write_max1k(struct dfu_dev *dfu,
   data_offset = dfu->dev_desc.bMaxPacketSize0;
   data_offset += offset % dfu->dev_desc.bMaxPacketSize0;
 
+  buffer = malloc(data_offset + size);
+  if (buffer == NULL) {
+    avrdude_message(MSG_INFO, "%s: Error: Out of memory\n", progname);
+    return -1;
+  }
+
   memcpy(buffer, &cmd, sizeof(cmd));
   memset(buffer + sizeof(cmd), 0, data_offset - sizeof(cmd));
   memcpy(buffer + data_offset, ptr, size);
 
   cmd_result = dfu_dnload(dfu, buffer, data_offset + size);
+  free(buffer);
 
   aux_result = dfu_getstatus(dfu, &status);
 
@@ -748,10 +748,11 @@ static int ft245r_tpi_tx(const PROGRAMMER *pgm, uint8_t byte) {
     return 0;
 }
 
-static int ft245r_tpi_rx(const PROGRAMMER *pgm, uint8_t *bytep) {
-    uint8_t buf[128], bit, parity;
-    int i, buf_pos = 0, len = 0;
-    uint32_t res, m, byte;
+/* Queue the bit pattern that samples the response to a TPI
+   instruction; returns its length */
+static int ft245r_tpi_rx_request(const PROGRAMMER *pgm) {
+    uint8_t buf[128];
+    int i, len = 0;
 
     /* Allow for up to 4 bits before we must see start bit; during
        that time, we must keep the MOSI line high. */
@@ -759,7 +760,15 @@ static int ft245r_tpi_rx(const PROGRAMMER *pgm, uint8_t *bytep) {
 	len += set_data(pgm, &buf[len], 0xff);
 
     ft245r_send(pgm, buf, len);
-    ft245r_recv(pgm, buf, len);
+    return len;
+}
+
+/* Decode a TPI response sampled by ft245r_tpi_rx_request() */
+static int ft245r_tpi_rx_decode(const PROGRAMMER *pgm, uint8_t *buf,
+				uint8_t *bytep) {
+    uint8_t bit, parity;
+    int i, buf_pos = 0;
+    uint32_t res, m, byte;
 
     res = (extract_tpi_data(pgm, buf, &buf_pos)
 	   | ((uint32_t) extract_tpi_data(pgm, buf, &buf_pos) << 8));
@@ -793,6 +802,16 @@ static int ft245r_tpi_rx(const PROGRAMMER *pgm, uint8_t *bytep) {
     return 0;
 }
 
+static int ft245r_tpi_rx(const PROGRAMMER *pgm, uint8_t *bytep) {
+    uint8_t buf[128];
+    int len;
+
+    len = ft245r_tpi_rx_request(pgm);
+    ft245r_recv(pgm, buf, len);
+
+    return ft245r_tpi_rx_decode(pgm, buf, bytep);
+}
+
 static int ft245r_cmd_tpi(const PROGRAMMER *pgm, const unsigned char *cmd,
 			  int cmd_len, unsigned char *res, int res_len) {
     int i, ret = 0;
@@ -818,6 +837,82 @@ static int ft245r_cmd_tpi(const PROGRAMMER *pgm, const unsigned char *cmd,
     return ret;
 }
 
+/*
+ * Execute a stream of TPI instructions (see tpi_insn_len()) with as
+ * few USB round trips as possible: all bit patterns, including those
+ * sampling responses, are queued first and the responses are only
+ * collected at the end of a segment.  A segment ends when the queued
+ * data could overrun the receive buffer, or at a delay.
+ */
+#define FT245R_TPI_SEGMENT	(FT245R_BUFSIZE / 2)
+
+static int ft245r_cmd_tpi_block(const PROGRAMMER *pgm, const unsigned char *cmd,
+				int cmd_len, unsigned char *res, int res_len) {
+    int skip[FT245R_TPI_SEGMENT / 32], rxlen[FT245R_TPI_SEGMENT / 32];
+    int i, j, n, nres, nrx = 0, got = 0, queued = 0, tail = 0, ret = 0;
+    uint8_t buf[128];
+
+    pgm->pgm_led(pgm, ON);
+
+    for (i = 0; i <= cmd_len && ret == 0; i += n) {
+	n = nres = 0;
+	if (i < cmd_len) {
+	    n = tpi_insn_len(cmd[i], &nres);
+	    if (i + n > cmd_len || got + nrx + nres > res_len) {
+		avrdude_message(MSG_INFO, "%s: malformed block at %d (cmd_len=%d/res_len=%d)\n",
+				__func__, i, cmd_len, res_len);
+		ret = -1;
+		break;
+	    }
+	}
+
+	/* Collect the responses queued so far */
+	if (i == cmd_len || cmd[i] == TPI_BLOCK_DELAY ||
+	    queued + (n*24 + nres*32) * baud_multiplier > FT245R_TPI_SEGMENT) {
+	    for (j = 0; j < nrx && ret == 0; j++) {
+		rx.discard += skip[j] * baud_multiplier;
+		if ((ret = ft245r_recv(pgm, buf, rxlen[j])) == 0)
+		    ret = ft245r_tpi_rx_decode(pgm, buf, &res[got++]);
+	    }
+	    rx.discard += tail * baud_multiplier;
+	    nrx = queued = tail = 0;
+	    if (i == cmd_len || ret)
+		break;
+	}
+
+	if (cmd[i] == TPI_BLOCK_DELAY) {
+	    ft245r_usleep(pgm, cmd[i+1] * TPI_BLOCK_DELAY_UNIT);
+	    continue;
+	}
+
+	for (j = 0; j < n; j++) {
+	    int len = set_tpi_data(pgm, buf, cmd[i+j]);
+	    ft245r_send(pgm, buf, len);
+	    tail += len;
+	    queued += len * baud_multiplier;
+	}
+	for (j = 0; j < nres; j++) {
+	    skip[nrx] = tail;
+	    rxlen[nrx] = ft245r_tpi_rx_request(pgm);
+	    queued += rxlen[nrx++] * baud_multiplier;
+	    tail = 0;
+	}
+    }
+
+    if (verbose >= 2) {
+	avrdude_message(MSG_NOTICE2, "%s: [ ", __func__);
+	for (i = 0; i < cmd_len; i++)
+	    avrdude_message(MSG_NOTICE2, "%02X ", cmd[i]);
+	avrdude_message(MSG_NOTICE2, "] [ ");
+	for(i = 0; i < got; i++)
+	    avrdude_message(MSG_NOTICE2, "%02X ", res[i]);
+	avrdude_message(MSG_NOTICE2, "]\n");
+    }
+
+    pgm->pgm_led(pgm, OFF);
+    return ret;
+}
+
 /* lower 8 pins are accepted, they might be also inverted */
 static const struct pindef_t valid_pins = {{0xff},{0xff}} ;
 
@@ -990,25 +1085,19 @@ static void ft245r_display(const PROGRAMMER *pgm, const char *p) {
 }
 
 
-static int ft245r_paged_write_gen(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
-             unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
-
-    for(int i=0; i < (int) n_bytes; i++, addr++)
-        if(avr_write_byte_default(pgm, p, m, addr, m->buf[addr]) != 0)
-            return -2;
-
-    return n_bytes;
-}
-
-
+/*
+ * Queue of outstanding bit patterns: each request is the number of
+ * bytes sent for a fragment and, for reads, where to put the n bytes
+ * read (NULL when the response is not needed)
+ */
 static struct ft245r_request {
-    int addr;
+    unsigned char *dst;
     int bytes;
     int n;
     struct ft245r_request *next;
 } *req_head,*req_tail,*req_pool;
 
-static void put_request(int addr, int bytes, int n) {
+static void put_request(unsigned char *dst, int bytes, int n) {
     struct ft245r_request *p;
     if (req_pool) {
         p = req_pool;
@@ -1021,7 +1110,7 @@ static void put_request(int addr, int bytes, int n) {
         }
     }
     memset(p, 0, sizeof(struct ft245r_request));
-    p->addr = addr;
+    p->dst = dst;
     p->bytes = bytes;
     p->n = n;
     if (req_tail) {
@@ -1032,9 +1121,10 @@ static void put_request(int addr, int bytes, int n) {
     }
 }
 
-static int do_request(const PROGRAMMER *pgm, const AVRMEM *m) {
+static int do_request(const PROGRAMMER *pgm) {
     struct ft245r_request *p;
-    int addr, bytes, j, n;
+    int bytes, j, n;
+    unsigned char *dst;
     unsigned char buf[FT245R_FRAGMENT_SIZE+1+128];
 
     if (!req_head) return 0;
@@ -1042,7 +1132,7 @@ static int do_request(const PROGRAMMER *pgm, const AVRMEM *m) {
     req_head = p->next;
     if (!req_head) req_tail = req_head;
 
-    addr = p->addr;
+    dst = p->dst;
     bytes = p->bytes;
     n = p->n;
     memset(p, 0, sizeof(struct ft245r_request));
@@ -1051,7 +1141,7 @@ static int do_request(const PROGRAMMER *pgm, const AVRMEM *m) {
 
     ft245r_recv(pgm, buf, bytes);
     for (j=0; j<n; j++) {
-        m->buf[addr++] = extract_data(pgm, buf , (j * 4 + 3));
+        *dst++ = extract_data(pgm, buf , (j * 4 + 3));
     }
     return 1;
 }
@@ -1098,13 +1188,13 @@ static int ft245r_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
                 buf_pos++;
             }
             ft245r_send(pgm, buf, buf_pos);
-            put_request(addr_save, buf_pos, 0);
+            put_request(NULL, buf_pos, 0);
 
             if(++req_count > REQ_OUTSTANDINGS)
-                do_request(pgm, m);
+                do_request(pgm);
 
             if(do_page_write) {
-                while(do_request(pgm, m))
+                while(do_request(pgm))
                     continue;
                 if(avr_write_page(pgm, p, m, addr_save - (addr_save % m->page_size)) != 0)
                     return -2;
@@ -1117,58 +1207,34 @@ static int ft245r_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
         }
     }
 
-    while(do_request(pgm, m))
+    while(do_request(pgm))
         continue;
 
     return n_bytes;
 }
 
 
-static int ft245r_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
-            unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
-
-    if(!n_bytes)
-        return 0;
-
-    if(strcmp(m->desc, "flash") == 0)
-        return ft245r_paged_write_flash(pgm, p, m, page_size, addr, n_bytes);
-
-    if(strcmp(m->desc, "eeprom") == 0)
-        return ft245r_paged_write_gen(pgm, p, m, page_size, addr, n_bytes);
-
-    return -2;
-}
-
-static int ft245r_paged_load_gen(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
-             unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
-
-    for(int i=0; i < (int) n_bytes; i++) {
-        unsigned char rbyte;
-
-        if(avr_read_byte_default(pgm, p, m, addr+i, &rbyte) != 0)
-            return -2;
-
-        m->buf[addr+i] = rbyte;
-    }
-
-    return 0;
-}
-
-
-static int ft245r_paged_load_flash(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
-            unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+/*
+ * Read n_bytes from addr into dst with queued read commands, collecting
+ * the responses only when REQ_OUTSTANDINGS fragments are in flight;
+ * flash is read with READ_LO/HI at word addresses, other memories with
+ * READ.  The range must not cross a 128 KiB boundary.
+ */
+static int ft245r_load_queued(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+            unsigned int addr, unsigned int n_bytes, unsigned char *dst) {
 
-    int i, j, addr_save, buf_pos, req_count;
+    int i, j, buf_pos, req_count, word = m->op[AVR_OP_READ_LO] != NULL;
     unsigned char buf[FT245R_FRAGMENT_SIZE+1];
     unsigned char cmd[4];
+    unsigned char *dst_save;
 
-    if(m->op[AVR_OP_READ_LO] == NULL || m->op[AVR_OP_READ_HI] == NULL) {
-        avrdude_message(MSG_INFO, "AVR_OP_READ_HI/LO command not defined for %s\n", p->desc);
+    if(word? m->op[AVR_OP_READ_HI] == NULL: m->op[AVR_OP_READ] == NULL) {
+        avrdude_message(MSG_INFO, "%s command not defined for %s %s\n",
+            word? "AVR_OP_READ_HI": "AVR_OP_READ", p->desc, m->desc);
         return -1;
     }
 
-    // always called with addr at page boundary, and n_bytes == m->page_size;
-    // hence, OK to prepend load extended address command (at most) once
+    // prepend load extended address command (at most) once, see ft245r_paged_load()
     if(m->op[AVR_OP_LOAD_EXT_ADDR]) {
         memset(cmd, 0, sizeof cmd);
 	avr_set_bits(m->op[AVR_OP_LOAD_EXT_ADDR], cmd);
@@ -1181,14 +1247,14 @@ static int ft245r_paged_load_flash(const PROGRAMMER *pgm, const AVRPART *p, cons
     }
 
     req_count = i = j = buf_pos = 0;
-    addr_save = addr;
+    dst_save = dst;
     while(i < (int) n_bytes) {
-        int spi = addr&1? AVR_OP_READ_HI: AVR_OP_READ_LO;
+        int spi = !word? AVR_OP_READ: addr&1? AVR_OP_READ_HI: AVR_OP_READ_LO;
 
         // put the SPI read command as FT245R_CMD_SIZE bytes into buffer
         memset(cmd, 0, sizeof cmd);
         avr_set_bits(m->op[spi], cmd);
-        avr_set_addr(m->op[spi], cmd, addr/2);
+        avr_set_addr(m->op[spi], cmd, word? addr/2: addr);
         for(int k=0; k<sizeof cmd; k++)
            buf_pos += set_data(pgm, buf+buf_pos, cmd[k]);
 
@@ -1205,36 +1271,173 @@ static int ft245r_paged_load_flash(const PROGRAMMER *pgm, const AVRPART *p, cons
                 buf_pos++;
             }
             ft245r_send(pgm, buf, buf_pos);
-            put_request(addr_save, buf_pos, j);
+            put_request(dst_save, buf_pos, j);
 
             if(++req_count > REQ_OUTSTANDINGS)
-                do_request(pgm, m);
+                do_request(pgm);
 
             // reset buffer variables
             j = buf_pos = 0;
-            addr_save = addr;
+            dst_save = dst + i;
         }
     }
 
-    while(do_request(pgm, m))
+    while(do_request(pgm))
         continue;
 
     return 0;
 }
 
-static int ft245r_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+
+// Queue an SPI command whose response is not needed
+static void ft245r_send_cmd(const PROGRAMMER *pgm, const OPCODE *op,
+            unsigned long addr, unsigned char data) {
+
+    unsigned char buf[FT245R_CMD_SIZE];
+    unsigned char cmd[4];
+    int buf_pos = 0;
+
+    memset(cmd, 0, sizeof cmd);
+    avr_set_bits(op, cmd);
+    avr_set_addr(op, cmd, addr);
+    avr_set_input(op, cmd, data);
+    for(int k=0; k<sizeof cmd; k++)
+        buf_pos += set_data(pgm, buf+buf_pos, cmd[k]);
+    ft245r_send_and_discard(pgm, buf, buf_pos);
+}
+
+// Wait usec once everything queued has been clocked out to the part
+static int ft245r_wait_idle(const PROGRAMMER *pgm, useconds_t usec) {
+    unsigned char sck_down;
+    int ret;
+
+    ft245r_out = SET_BITS_0(ft245r_out, pgm, PIN_AVR_SCK, 0);
+    sck_down = ft245r_out;
+    ft245r_send_and_discard(pgm, &sck_down, 1);
+    ret = ft245r_recv(pgm, NULL, 0);
+    usleep(usec);
+
+    return ret;
+}
+
+#define FT245R_POLL_TRIES 10
+
+/*
+ * Write EEPROM from the command queue rather than one byte at a time
+ * with avr_write_byte_default().  The current contents are read with
+ * queued commands first so that unchanged bytes, or pages, are skipped.
+ * The write commands are sent without collecting their responses, and
+ * the write delay only waits for the queue to drain; readiness is polled
+ * once at the end of the batch.  Parts with loadpage and writepage
+ * commands for EEPROM are written a page at a time.
+ */
+static int ft245r_paged_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
              unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
 
+    OPCODE *load = m->op[AVR_OP_LOADPAGE_LO], *wpage = m->op[AVR_OP_WRITEPAGE];
+    int paged = load && wpage && m->page_size > 1, written = 0, rc = n_bytes;
+    unsigned int i, k, end = addr + n_bytes, last = 0;
+    unsigned char *old, r;
+
+    if(!paged && m->op[AVR_OP_WRITE] == NULL)
+        return -2;
+
+    if((old = malloc(n_bytes)) == NULL) {
+        avrdude_message(MSG_INFO, "%s: out of memory\n", __func__);
+        return -2;
+    }
+
+    // the AT90S1200 must not be read before writing, see avr_write_byte_default()
+    if(p->flags & AVRPART_IS_AT90S1200) {
+        for(i = 0; i < n_bytes; i++)
+            old[i] = ~m->buf[addr+i];
+    } else if(ft245r_load_queued(pgm, p, m, addr, n_bytes, old) < 0) {
+        free(old);
+        return -2;
+    }
+
+    pgm->pgm_led(pgm, ON);
+    for(i = addr; i < end; i = k) {
+        k = paged? (i/m->page_size + 1) * m->page_size: i + 1;
+        if(k > end)
+            k = end;
+        if(memcmp(old + (i - addr), m->buf + i, k - i) == 0)
+            continue;
+
+        if(paged) {
+            for(unsigned int a = i; a < k; a++)
+                ft245r_send_cmd(pgm, load, a, m->buf[a]);
+            ft245r_send_cmd(pgm, wpage, i, 0);
+        } else
+            ft245r_send_cmd(pgm, m->op[AVR_OP_WRITE], i, m->buf[i]);
+
+        if(ft245r_wait_idle(pgm, m->max_write_delay) < 0) {
+            rc = -2;
+            break;
+        }
+        last = k - 1;
+        written++;
+    }
+
+    // poll the last byte written, unless its value cannot be told from a busy part
+    if(rc > 0 && written && m->buf[last] != m->readback[0] && m->buf[last] != m->readback[1]) {
+        for(int tries = 0; ; tries++) {
+            if(pgm->read_byte(pgm, p, m, last, &r) != 0) {
+                rc = -2;
+                break;
+            }
+            if(r == m->buf[last])
+                break;
+            if(tries >= FT245R_POLL_TRIES) {
+                avrdude_message(MSG_INFO, "%s: %s write at 0x%04x not completed\n",
+                    __func__, m->desc, last);
+                rc = -2;
+                break;
+            }
+            usleep(m->max_write_delay/FT245R_POLL_TRIES + 1);
+        }
+    }
+    pgm->pgm_led(pgm, OFF);
+
+    free(old);
+    return rc;
+}
+
+
+static int ft245r_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+            unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+
     if(!n_bytes)
         return 0;
 
     if(strcmp(m->desc, "flash") == 0)
-        return ft245r_paged_load_flash(pgm, p, m, page_size, addr, n_bytes);
+        return ft245r_paged_write_flash(pgm, p, m, page_size, addr, n_bytes);
 
-   if(strcmp(m->desc, "eeprom") == 0)
-        return ft245r_paged_load_gen(pgm, p, m, page_size, addr, n_bytes);
+    if(strcmp(m->desc, "eeprom") == 0)
+        return ft245r_paged_write_eeprom(pgm, p, m, page_size, addr, n_bytes);
+
+    return -2;
+}
 
-   return -2;
+static int ft245r_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+             unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+
+    unsigned int n;
+    int rc;
+
+    if(strcmp(m->desc, "flash") != 0 && strcmp(m->desc, "eeprom") != 0)
+        return -2;
+
+    // split at 128 KiB boundaries, where the extended address changes
+    for(; n_bytes > 0; addr += n, n_bytes -= n) {
+        n = n_bytes;
+        if(m->op[AVR_OP_LOAD_EXT_ADDR] && addr/0x20000 != (addr + n - 1)/0x20000)
+            n = 0x20000 - addr%0x20000;
+        if((rc = ft245r_load_queued(pgm, p, m, addr, n, m->buf + addr)) < 0)
+            return rc;
+    }
+
+    return 0;
 }
 
 void ft245r_initpgm(PROGRAMMER *pgm) {
@@ -1251,6 +1454,7 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
     pgm->chip_erase     = ft245r_chip_erase;
     pgm->cmd            = ft245r_cmd;
     pgm->cmd_tpi        = ft245r_cmd_tpi;
+    pgm->cmd_tpi_block  = ft245r_cmd_tpi_block;
     pgm->open           = ft245r_open;
     pgm->close          = ft245r_close;
     pgm->read_byte      = avr_read_byte_default;
@@ -1261,6 +1465,7 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
      */
     pgm->paged_write = ft245r_paged_write;
     pgm->paged_load = ft245r_paged_load;
+    pgm->max_paged_xfer = 1024;
 
     pgm->rdy_led        = set_led_rdy;
     pgm->err_led        = set_led_err;
@@ -74,6 +74,9 @@ struct pdata
   /* Flag for triggering HV UPDI */
   bool use_hvupdi;
 
+  /* Verify UPDI flash with CRCSCAN rather than reading it back */
+  int crc_verify;
+
   /* Function to set the appropriate clock parameter */
   int (*set_sck)(const PROGRAMMER *, unsigned char *);
 };
@@ -1492,6 +1495,12 @@ static int jtag3_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
       continue;
     }
 
+    else if ((strcmp(extended_param, "crcverify") == 0) &&
+             (pgm->flag & PGM_FL_IS_UPDI)) {
+      PDATA(pgm)->crc_verify = 1;
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: jtag3_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
     rv = -1;
@@ -2317,6 +2326,68 @@ int jtag3_setparm(const PROGRAMMER *pgm, unsigned char scope,
   return status;
 }
 
+/*
+ * Read/write a single byte of the UPDI data space, used to drive the
+ * CRCSCAN peripheral
+ */
+static int jtag3_read_data(const PROGRAMMER *pgm, unsigned long addr, unsigned char *value) {
+  unsigned char cmd[12];
+  unsigned char *resp;
+  int status;
+
+  cmd[0] = SCOPE_AVR;
+  cmd[1] = CMD3_READ_MEMORY;
+  cmd[2] = 0;
+  cmd[3] = MTYPE_SRAM;
+  u32_to_b4(cmd + 4, addr);
+  u32_to_b4(cmd + 8, 1);
+
+  if ((status = jtag3_command(pgm, cmd, 12, &resp, "read memory")) < 0)
+    return status;
+
+  if (resp[1] != RSP3_DATA || status < 4) {
+    avrdude_message(MSG_INFO, "%s: wrong/short reply to read memory command\n",
+	    progname);
+    free(resp);
+    return -1;
+  }
+
+  *value = resp[3];
+  free(resp);
+  return 0;
+}
+
+static int jtag3_write_data(const PROGRAMMER *pgm, unsigned long addr, unsigned char value) {
+  unsigned char cmd[14];
+  unsigned char *resp;
+  int status;
+
+  cmd[0] = SCOPE_AVR;
+  cmd[1] = CMD3_WRITE_MEMORY;
+  cmd[2] = 0;
+  cmd[3] = MTYPE_SRAM;
+  u32_to_b4(cmd + 4, addr);
+  u32_to_b4(cmd + 8, 1);
+  cmd[12] = 0;
+  cmd[13] = value;
+
+  if ((status = jtag3_command(pgm, cmd, 14, &resp, "write memory")) < 0)
+    return status;
+
+  free(resp);
+  return 0;
+}
+
+static int jtag3_verify_crc(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  if (!PDATA(pgm)->crc_verify)
+    return 0;
+
+  if (jtag3_program_enable(pgm) < 0)
+    return -1;
+
+  return avr_crcscan_verify(pgm, p, m, jtag3_read_data, jtag3_write_data);
+}
+
 int jtag3_read_sib(const PROGRAMMER *pgm, const AVRPART *p, char *sib) {
   int status;
   unsigned char cmd[12];
@@ -2600,6 +2671,7 @@ void jtag3_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = jtag3_setup;
   pgm->teardown       = jtag3_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
   pgm->flag           = PGM_FL_IS_JTAG;
 
   for(LNODEID ln=lfirst(pgm->id); ln; ln=lnext(ln)) {
@@ -2638,6 +2710,7 @@ void jtag3_dw_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = jtag3_setup;
   pgm->teardown       = jtag3_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
   pgm->flag           = PGM_FL_IS_DW;
 
   for(LNODEID ln=lfirst(pgm->id); ln; ln=lnext(ln)) {
@@ -2678,6 +2751,7 @@ void jtag3_pdi_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = jtag3_setup;
   pgm->teardown       = jtag3_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
   pgm->flag           = PGM_FL_IS_PDI;
 
   for(LNODEID ln=lfirst(pgm->id); ln; ln=lnext(ln)) {
@@ -2719,9 +2793,11 @@ void jtag3_updi_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = jtag3_setup;
   pgm->teardown       = jtag3_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
   pgm->flag           = PGM_FL_IS_UPDI;
   pgm->unlock         = jtag3_unlock_erase_key;
   pgm->read_sib       = jtag3_read_sib;
+  pgm->verify_crc     = jtag3_verify_crc;
 
   for(LNODEID ln=lfirst(pgm->id); ln; ln=lnext(ln)) {
     if (matches(ldata(ln), "powerdebugger") ||
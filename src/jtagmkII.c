@@ -50,6 +50,8 @@
 #include "jtagmkII_private.h"
 #include "usbdevs.h"
 
+#define JTAGMKII_MAX_PAGE 256	/* Largest page jtagmkII_paged_write() sends */
+
 /*
  * Private data for this programmer.
  */
@@ -88,10 +90,31 @@ struct pdata
 #define FLAGS32_WRITE         2 // At least one write operation specified
   // Couple of flag bits for AVR32 programming
   int flags32;
+
+  /*
+   * Frame buffer for jtagmkII_paged_write(): frame header, write
+   * memory command, one page of data and CRC.
+   */
+  unsigned char framebuf[8 + 10 + JTAGMKII_MAX_PAGE + 2];
+
+  /* Don't send the next page before the previous one is acknowledged */
+  int no_pipeline;
+
+  /* Statistics, reported at -v */
+  unsigned long frames_sent;
+  unsigned long frame_bytes;
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
 
+/*
+ * Number of write memory commands jtagmkII_paged_write() keeps in
+ * flight on USB connections.  The ICE handles one command at a time;
+ * the second one waits in the USB endpoint, so the next page is
+ * already there when the previous one has been written.
+ */
+#define JTAGMKII_PIPELINE_DEPTH 2
+
 /*
  * The OCDEN fuse is bit 7 of the high fuse (hfuse).  In order to
  * perform memory operations on MTYPE_SPM and MTYPE_EEPROM, OCDEN
@@ -183,6 +206,10 @@ void jtagmkII_setup(PROGRAMMER *pgm) {
 }
 
 void jtagmkII_teardown(PROGRAMMER *pgm) {
+  if (PDATA(pgm)->frames_sent)
+    avrdude_message(MSG_NOTICE, "%s: %lu frames sent, %lu bytes per frame on average\n",
+                    progname, PDATA(pgm)->frames_sent,
+                    PDATA(pgm)->frame_bytes / PDATA(pgm)->frames_sent);
   free(pgm->cookie);
 }
 
@@ -417,8 +444,35 @@ static void jtagmkII_prmsg(const PROGRAMMER *pgm, unsigned char *data, size_t le
 }
 
 
+/*
+ * Send the len bytes of payload at buf + 8 as a frame with sequence
+ * number seqno.  buf must have room for the 8 header bytes in front of
+ * the payload and the 2 CRC bytes after it.
+ */
+static int jtagmkII_send_frame(const PROGRAMMER *pgm, unsigned char *buf, size_t len,
+                               unsigned short seqno) {
+  buf[0] = MESSAGE_START;
+  u16_to_b2(buf + 1, seqno);
+  u32_to_b4(buf + 3, len);
+  buf[7] = TOKEN;
+
+  crcappend(buf, len + 8);
+
+  if (serial_send(&pgm->fd, buf, len + 10) != 0) {
+    avrdude_message(MSG_INFO, "%s: jtagmkII_send(): failed to send command to serial port\n",
+                    progname);
+    return -1;
+  }
+
+  PDATA(pgm)->frames_sent++;
+  PDATA(pgm)->frame_bytes += len;
+
+  return 0;
+}
+
 int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   unsigned char *buf;
+  int rv;
 
   avrdude_message(MSG_DEBUG, "\n%s: jtagmkII_send(): sending %lu bytes\n",
 	    progname, (unsigned long)len);
@@ -430,24 +484,12 @@ int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
       return -1;
     }
 
-  buf[0] = MESSAGE_START;
-  u16_to_b2(buf + 1, PDATA(pgm)->command_sequence);
-  u32_to_b4(buf + 3, len);
-  buf[7] = TOKEN;
   memcpy(buf + 8, data, len);
-
-  crcappend(buf, len + 8);
-
-  if (serial_send(&pgm->fd, buf, len + 10) != 0) {
-    avrdude_message(MSG_INFO, "%s: jtagmkII_send(): failed to send command to serial port\n",
-                    progname);
-    free(buf);
-    return -1;
-  }
+  rv = jtagmkII_send_frame(pgm, buf, len, PDATA(pgm)->command_sequence);
 
   free(buf);
 
-  return 0;
+  return rv;
 }
 
 
@@ -1480,6 +1522,11 @@ static int jtagmkII_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
       continue;
     }
 
+    if (strcmp(extended_param, "nopipeline") == 0) {
+      PDATA(pgm)->no_pipeline = 1;
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: jtagmkII_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
     rv = -1;
@@ -1975,9 +2022,12 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 {
   unsigned int block_size;
   unsigned int maxaddr = addr + n_bytes;
-  unsigned char *cmd;
+  unsigned int sendaddr;
+  unsigned char *cmd = PDATA(pgm)->framebuf + 8;
+  unsigned char memtype;
   unsigned char *resp;
   int status, tries, dynamic_memtype = 0;
+  int depth, inflight;
   long otimeout = serial_recv_timeout;
 
   avrdude_message(MSG_NOTICE2, "%s: jtagmkII_paged_write(.., %s, %d, %d)\n",
@@ -1986,19 +2036,12 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
   if (!(pgm->flag & PGM_FL_IS_DW) && jtagmkII_program_enable(pgm) < 0)
     return -1;
 
-  if (page_size == 0) page_size = 256;
-  else if (page_size > 256) page_size = 256;
-
-  if ((cmd = malloc(page_size + 10)) == NULL) {
-    avrdude_message(MSG_INFO, "%s: jtagmkII_paged_write(): Out of memory\n",
-	    progname);
-    return -1;
-  }
+  if (page_size == 0) page_size = JTAGMKII_MAX_PAGE;
+  else if (page_size > JTAGMKII_MAX_PAGE) page_size = JTAGMKII_MAX_PAGE;
 
-  cmd[0] = CMND_WRITE_MEMORY;
   if (strcmp(m->desc, "flash") == 0) {
     PDATA(pgm)->flash_pageaddr = (unsigned long)-1L;
-    cmd[1] = jtagmkII_memtype(pgm, p, addr);
+    memtype = jtagmkII_memtype(pgm, p, addr);
     if (p->prog_modes & (PM_PDI | PM_UPDI))
       /* dynamically decide between flash/boot memtype */
       dynamic_memtype = 1;
@@ -2010,59 +2053,74 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
        */
       for (; addr < maxaddr; addr++) {
 	status = jtagmkII_write_byte(pgm, p, m, addr, m->buf[addr]);
-	if (status < 0) {
-	  free(cmd);
+	if (status < 0)
 	  return -1;
-	}
       }
-      free(cmd);
       return n_bytes;
     }
-    cmd[1] = p->prog_modes & (PM_PDI | PM_UPDI)? MTYPE_EEPROM: MTYPE_EEPROM_PAGE;
+    memtype = p->prog_modes & (PM_PDI | PM_UPDI)? MTYPE_EEPROM: MTYPE_EEPROM_PAGE;
     PDATA(pgm)->eeprom_pageaddr = (unsigned long)-1L;
   } else if (strcmp(m->desc, "usersig") == 0 ||
              strcmp(m->desc, "userrow") == 0) {
-    cmd[1] = MTYPE_USERSIG;
+    memtype = MTYPE_USERSIG;
   } else if (strcmp(m->desc, "boot") == 0) {
-    cmd[1] = MTYPE_BOOT_FLASH;
+    memtype = MTYPE_BOOT_FLASH;
   } else if (p->prog_modes & (PM_PDI | PM_UPDI)) {
-    cmd[1] = MTYPE_FLASH;
+    memtype = MTYPE_FLASH;
   } else {
-    cmd[1] = MTYPE_SPM;
+    memtype = MTYPE_SPM;
   }
-  serial_recv_timeout = 200;
-  for (; addr < maxaddr; addr += page_size) {
-    if ((maxaddr - addr) < page_size)
-      block_size = maxaddr - addr;
-    else
-      block_size = page_size;
-    avrdude_message(MSG_DEBUG, "%s: jtagmkII_paged_write(): "
-	      "block_size at addr %d is %d\n",
-	      progname, addr, block_size);
 
-    if (dynamic_memtype)
-      cmd[1] = jtagmkII_memtype(pgm, p, addr);
+  /*
+   * Over USB, the next page can be sent while the ICE is still busy
+   * with the previous one.  A serial line has no flow control, so
+   * there the ICE must answer each page before the next one is sent.
+   */
+  depth = 1;
+#if defined(HAVE_LIBUSB)
+  if (serdev == &usb_serdev && !(pgm->flag & PGM_FL_IS_DW) && !PDATA(pgm)->no_pipeline)
+    depth = JTAGMKII_PIPELINE_DEPTH;
+#endif
 
-    u32_to_b4(cmd + 2, page_size);
-    u32_to_b4(cmd + 6, jtagmkII_memaddr(pgm, p, m, addr));
+  serial_recv_timeout = 200;
+  tries = 0;
+  inflight = 0;
+  sendaddr = addr;
+  while (addr < maxaddr) {
+    /* Keep up to depth pages in flight; addr is the oldest one */
+    while (sendaddr < maxaddr && inflight < depth) {
+      if ((maxaddr - sendaddr) < page_size)
+        block_size = maxaddr - sendaddr;
+      else
+        block_size = page_size;
+      avrdude_message(MSG_DEBUG, "%s: jtagmkII_paged_write(): "
+                "block_size at addr %d is %d\n",
+                progname, sendaddr, block_size);
 
-    /*
-     * The JTAG ICE will refuse to write anything but a full page, at
-     * least for the flash ROM.  If a partial page has been requested,
-     * set the remainder to 0xff.  (Maybe we should rather read back
-     * the existing contents instead before?  Doesn't matter much, as
-     * bits cannot be written to 1 anyway.)
-     */
-    memset(cmd + 10, 0xff, page_size);
-    memcpy(cmd + 10, m->buf + addr, block_size);
+      cmd[0] = CMND_WRITE_MEMORY;
+      cmd[1] = dynamic_memtype? jtagmkII_memtype(pgm, p, sendaddr): memtype;
+      u32_to_b4(cmd + 2, page_size);
+      u32_to_b4(cmd + 6, jtagmkII_memaddr(pgm, p, m, sendaddr));
 
-    tries = 0;
+      /*
+       * The JTAG ICE will refuse to write anything but a full page, at
+       * least for the flash ROM.  If a partial page has been requested,
+       * set the remainder to 0xff.  (Maybe we should rather read back
+       * the existing contents instead before?  Doesn't matter much, as
+       * bits cannot be written to 1 anyway.)
+       */
+      memset(cmd + 10, 0xff, page_size);
+      memcpy(cmd + 10, m->buf + sendaddr, block_size);
 
-    retry:
       avrdude_message(MSG_NOTICE2, "%s: jtagmkII_paged_write(): "
-	      "Sending write memory command: ",
-	      progname);
-    jtagmkII_send(pgm, cmd, page_size + 10);
+                "Sending write memory command: ",
+                progname);
+      /* Responses come back in order, so frame i gets sequence number seq + i */
+      jtagmkII_send_frame(pgm, PDATA(pgm)->framebuf, page_size + 10,
+        (PDATA(pgm)->command_sequence + inflight) % 0xffff);
+      inflight++;
+      sendaddr += block_size;
+    }
 
     status = jtagmkII_recv(pgm, &resp);
     if (status <= 0) {
@@ -2071,16 +2129,25 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
       avrdude_message(MSG_INFO, "%s: jtagmkII_paged_write(): "
                         "timeout/error communicating with programmer (status %d)\n",
                         progname, status);
-      if (tries++ < 4) {
+      if (depth > 1) {
+        /* Resend the unacknowledged pages one at a time from now on */
+        avrdude_message(MSG_INFO, "%s: jtagmkII_paged_write(): "
+                        "falling back to one page per command\n", progname);
+        PDATA(pgm)->no_pipeline = 1;
+        depth = 1;
+      } else if (tries++ < 4) {
 	serial_recv_timeout *= 2;
-	goto retry;
+      } else {
+        avrdude_message(MSG_INFO, "%s: jtagmkII_paged_write(): fatal timeout/"
+                        "error communicating with programmer (status %d)\n",
+                        progname, status);
+        serial_recv_timeout = otimeout;
+        return -1;
       }
-      avrdude_message(MSG_INFO, "%s: jtagmkII_paged_write(): fatal timeout/"
-                      "error communicating with programmer (status %d)\n",
-                      progname, status);
-      free(cmd);
-      serial_recv_timeout = otimeout;
-      return -1;
+      jtagmkII_drain(pgm, 0);
+      inflight = 0;
+      sendaddr = addr;
+      continue;
     }
     if (verbose >= 3) {
       putc('\n', stderr);
@@ -2092,14 +2159,21 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
                       "bad response to write memory command: %s\n",
                       progname, jtagmkII_get_rc(resp[0]));
       free(resp);
-      free(cmd);
+      if (inflight > 1) {
+        /* Collect the answers to the pages sent after the failed one */
+        while (--inflight > 0 && jtagmkII_recv(pgm, &resp) > 0)
+          free(resp);
+      }
       serial_recv_timeout = otimeout;
       return -1;
     }
     free(resp);
+
+    inflight--;
+    tries = 0;
+    addr += (maxaddr - addr) < page_size? maxaddr - addr: page_size;
   }
 
-  free(cmd);
   serial_recv_timeout = otimeout;
 
   return n_bytes;
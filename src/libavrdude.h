@@ -344,6 +344,7 @@ int intlog2(unsigned int n);
 /* Functions for OPCODE structures */
 OPCODE * avr_new_opcode(void);
 void     avr_free_opcode(OPCODE * op);
+OPCODE * avr_intern_opcode(OPCODE * op);
 int avr_set_bits(const OPCODE *op, unsigned char *cmd);
 int avr_set_addr(const OPCODE *op, unsigned char *cmd, unsigned long addr);
 int avr_set_addr_mem(const AVRMEM *mem, int opnum, unsigned char *cmd, unsigned long addr);
@@ -665,6 +666,37 @@ extern struct serial_device usbhid_serdev;
 #define serial_drain (serdev->drain)
 #define serial_set_dtr_rts (serdev->set_dtr_rts)
 
+// See baudcache.c
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+long serial_baud_cache_get(const char *port);
+void serial_baud_cache_put(const char *port, long baud);
+
+void serial_rtt_sample(long usecs);
+long serial_rtt_timeout(int attempt);
+
+#ifdef __cplusplus
+}
+#endif
+
+// See trace.c
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int trace_open(const char *filename);
+void trace_close(void);
+void trace_begin(const char *name);
+void trace_end(void);
+void trace_instant(const char *name);
+void trace_counter(const char *name, long value);
+
+#ifdef __cplusplus
+}
+#endif
+
 // See avrcache.c
 typedef struct {                // Memory cache for a subset of cached pages
   int size, page_size;          // Size of cache (flash or eeprom size) and page size
@@ -744,6 +776,7 @@ typedef struct programmer_t {
   int ppictrl;
   int ispdelay;                 // ISP clock delay
   int page_size;                // Page size if the programmer supports paged write/load
+  int max_paged_xfer;           // Max bytes per paged_load()/paged_write() call, 0: one page
   double bitclock;              // JTAG ICE clock period in microseconds
 
   int  (*rdy_led)        (const struct programmer_t *pgm, int value);
@@ -763,6 +796,8 @@ typedef struct programmer_t {
                           unsigned char *res);
   int  (*cmd_tpi)        (const struct programmer_t *pgm, const unsigned char *cmd,
                           int cmd_len, unsigned char res[], int res_len);
+  int  (*cmd_tpi_block)  (const struct programmer_t *pgm, const unsigned char *cmd,
+                          int cmd_len, unsigned char res[], int res_len);
   int  (*spi)            (const struct programmer_t *pgm, const unsigned char *cmd,
                           unsigned char *res, int count);
   int  (*open)           (struct programmer_t *pgm, const char *port);
@@ -782,6 +817,7 @@ typedef struct programmer_t {
                           unsigned long addr, unsigned char *value);
   int  (*read_sig_bytes) (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m);
   int  (*read_sib)       (const struct programmer_t *pgm, const AVRPART *p, char *sib);
+  int  (*verify_crc)     (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m);
   void (*print_parms)    (const struct programmer_t *pgm);
   int  (*set_vtarget)    (const struct programmer_t *pgm, double v);
   int  (*set_varef)      (const struct programmer_t *pgm, unsigned int chan, double v);
@@ -847,16 +883,34 @@ void sort_programmers(LISTID programmers);
 
 typedef void (*FP_UpdateProgress)(int percent, double etime, const char *hdr, int finish);
 
+/* Machine-readable progress, passed to progress_event() by report_progress() */
+typedef struct {
+  const char *phase;            // Header of the operation, eg, "Reading" or "Writing"
+  const char *memory;           // Memory worked on or NULL, see report_progress_memory()
+  const char *state;            // "start", "progress", "done" or "failed"
+  long done, total;             // Work done and total work, bytes for memory reads/writes
+  double elapsed;               // Seconds since the start of the operation
+  double rate;                  // Work done per second
+  double eta;                   // Estimated seconds to go, -1 if not known yet
+  int retries;                  // Retries since the start of the operation
+} PROGRESS_EVENT;
+
+typedef void (*FP_ProgressEvent)(const PROGRESS_EVENT *ev);
+
 extern struct avrpart parts[];
 extern const char *avr_mem_order[100];
 
 extern FP_UpdateProgress update_progress;
+extern FP_ProgressEvent progress_event;
+extern int progress_event_hz;   // Max progress events per second while in progress, 0: no limit
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm);
+int avr_tpi_cmd_block(const PROGRAMMER *pgm, const unsigned char *cmd, int cmd_len,
+                      unsigned char *res, int res_len);
 int avr_tpi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p);
 int avr_tpi_program_enable(const PROGRAMMER *pgm, const AVRPART *p, unsigned char guard_time);
 int avr_read_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
@@ -883,6 +937,10 @@ int avr_signature(const PROGRAMMER *pgm, const AVRPART *p);
 
 int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int size);
 
+int avr_crcscan_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int (*read_data)(const PROGRAMMER *pgm, unsigned long addr, unsigned char *value),
+  int (*write_data)(const PROGRAMMER *pgm, unsigned long addr, unsigned char value));
+
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles);
 
 int avr_put_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int cycles);
@@ -906,6 +964,10 @@ int avr_unlock(const PROGRAMMER *pgm, const AVRPART *p);
 
 void report_progress(int completed, int total, const char *hdr);
 
+void report_progress_memory(const char *memdesc);
+
+void report_progress_retry(void);
+
 int avr_has_paged_access(const PROGRAMMER *pgm, const AVRMEM *m);
 
 int avr_read_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, unsigned char *buf);
@@ -967,6 +1029,8 @@ int fileio_fmt_autodetect(const char * fname);
 int fileio(int oprwv, char * filename, FILEFMT format,
            struct avrpart * p, char * memtype, int size);
 
+int fileio_elf_has_mem(char * filename, struct avrpart * p, char * memtype);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1017,6 +1081,10 @@ extern UPDATE * new_update(int op, char * memtype, int filefmt,
 extern void free_update(UPDATE * upd);
 extern int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd,
 		 enum updateflags flags);
+extern int do_ops(PROGRAMMER * pgm, struct avrpart * p, LISTID updates,
+		  enum updateflags flags);
+extern const char *update_base;  // Base image for delta programming of flash, NULL: none
+extern int update_base_check(const PROGRAMMER *pgm, const AVRPART *p, enum updateflags *flags);
 
 extern int memstats(struct avrpart *p, char *memtype, int size, Filestats *fsp);
 
@@ -1031,6 +1099,7 @@ int update_is_okfile(const char *fn);
 int update_is_writeable(const char *fn);
 int update_is_readable(const char *fn);
 
+int update_expand_all(struct avrpart *p, LISTID updates);
 int update_dryrun(struct avrpart *p, UPDATE *upd);
 
 
@@ -1087,6 +1156,16 @@ void *cfg_malloc(const char *funcname, size_t n);
 
 char *cfg_strdup(const char *funcname, const char *s);
 
+void *cfg_arena_malloc(const char *funcname, size_t n);
+
+void *cfg_part_malloc(const char *funcname, size_t n);
+
+int cfg_in_arena(const void *p);
+
+const void *cfg_intern(const void *obj, size_t n);
+
+void cfg_arena_release(void);
+
 int init_config(void);
 
 void cleanup_config(void);
@@ -365,6 +365,7 @@ void linuxgpio_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->cmd_tpi_block  = bitbang_cmd_tpi_block;
   pgm->open           = linuxgpio_open;
   pgm->close          = linuxgpio_close;
   pgm->setpin         = linuxgpio_setpin;
@@ -372,6 +373,8 @@ void linuxgpio_initpgm(PROGRAMMER *pgm) {
   pgm->highpulsepin   = linuxgpio_highpulsepin;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = bitbang_paged_load;
+  pgm->paged_write    = bitbang_paged_write;
 }
 
 const char linuxgpio_desc[] = "GPIO bitbanging using the Linux sysfs interface";
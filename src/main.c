@@ -41,6 +41,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -49,6 +50,7 @@
 #include "avrdude.h"
 #include "libavrdude.h"
 
+#include "daemon.h"
 #include "term.h"
 #include "developer_opts.h"
 
@@ -81,6 +83,8 @@ struct list_walk_cookie
 
 static LISTID updates = NULL;
 
+static LISTID update_specs = NULL; // -U strings as given, for --connect
+
 static LISTID extended_params = NULL;
 
 static LISTID additional_config_files = NULL;
@@ -97,6 +101,28 @@ int    ovsigck;     /* 1=override sig check, 0=don't */
 
 
 
+/* Options without a short form; getopt_long() returns these values */
+enum {
+  OPT_PROGRESS_FD = 0x100,
+  OPT_PROGRESS_HZ,
+  OPT_TRACE,
+  OPT_BASE,
+  OPT_DAEMON,
+  OPT_CONNECT,
+  OPT_STOP,
+};
+
+static const struct option long_options[] = {
+  {"progress-fd", required_argument, NULL, OPT_PROGRESS_FD},
+  {"progress-hz", required_argument, NULL, OPT_PROGRESS_HZ},
+  {"trace", required_argument, NULL, OPT_TRACE},
+  {"base", required_argument, NULL, OPT_BASE},
+  {"daemon", required_argument, NULL, OPT_DAEMON},
+  {"connect", required_argument, NULL, OPT_CONNECT},
+  {"stop", no_argument, NULL, OPT_STOP},
+  {NULL, 0, NULL, 0}
+};
+
 /*
  * usage message
  */
@@ -119,8 +145,9 @@ static void usage(void)
  "  -O                         Perform RC oscillator calibration (see AVR053). \n"
  "  -U <memtype>:r|w|v:<filename>[:format]\n"
  "                             Memory operation specification.\n"
- "                             Multiple -U options are allowed, each request\n"
- "                             is performed in the order specified.\n"
+ "                             Multiple -U options are allowed; they are merged\n"
+ "                             and reordered where that does not change results.\n"
+ "                             -U all:w:<file.elf> writes all memories in file.\n"
  "  -n                         Do not write anything to the device.\n"
  "  -V                         Do not verify.\n"
  "  -t                         Enter terminal mode.\n"
@@ -129,6 +156,13 @@ static void usage(void)
  "  -v                         Verbose output. -v -v for more.\n"
  "  -q                         Quell progress output. -q -q for less.\n"
  "  -l logfile                 Use logfile rather than stderr for diagnostics.\n"
+ "  --base <file>              Only write flash pages that differ from base image on device.\n"
+ "  --daemon <socket>          Keep programmer open and serve requests on Unix socket.\n"
+ "  --connect <socket>         Send -U and terminal commands to daemon on socket.\n"
+ "  --stop                     With --connect, stop the daemon afterwards.\n"
+ "  --progress-fd <fd>         Write progress events as JSON lines to file descriptor fd.\n"
+ "  --progress-hz <rate>       Max progress events per second (default 10, 0 = all).\n"
+ "  --trace <file>             Write a session timeline in Chrome trace format to file.\n"
  "  -?                         Display this usage.\n"
  "\navrdude version %s, URL: <https://github.com/avrdudes/avrdude>\n",
     progname, version);
@@ -316,6 +350,10 @@ static void cleanup_main(void)
         ldestroy_cb(updates, (void(*)(void*))free_update);
         updates = NULL;
     }
+    if (update_specs) {
+        ldestroy(update_specs);
+        update_specs = NULL;
+    }
     if (extended_params) {
         ldestroy(extended_params);
         extended_params = NULL;
@@ -326,6 +364,7 @@ static void cleanup_main(void)
     }
 
     cleanup_config();
+    trace_close();
 }
 
 static void replace_backslashes(char *s)
@@ -414,6 +453,10 @@ int main(int argc, char * argv [])
   int     init_ok;     /* Device initialization worked well */
   int     is_open;     /* Device open succeeded */
   char  * logfile;     /* Use logfile rather than stderr for diagnostics */
+  int     progress_fd; /* Write JSON progress events to this file descriptor */
+  const char *daemon_socket;  /* --daemon: serve requests on this socket */
+  const char *connect_socket; /* --connect: send requests to daemon on this socket */
+  int     stop_daemon; /* --stop: ask the daemon to exit */
   enum updateflags uflags = UF_AUTO_ERASE | UF_VERIFY; /* Flags for do_op() */
 
 #if !defined(WIN32)
@@ -461,6 +504,12 @@ int main(int argc, char * argv [])
     exit(1);
   }
 
+  update_specs = lcreat(NULL, 0);
+  if (update_specs == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot initialize updater list\n", progname);
+    exit(1);
+  }
+
   extended_params = lcreat(NULL, 0);
   if (extended_params == NULL) {
     avrdude_message(MSG_INFO, "%s: cannot initialize extended parameter list\n", progname);
@@ -490,6 +539,10 @@ int main(int argc, char * argv [])
   ispdelay      = 0;
   is_open       = 0;
   logfile       = NULL;
+  progress_fd   = -1;
+  daemon_socket = NULL;
+  connect_socket = NULL;
+  stop_daemon   = 0;
 
   len = strlen(progname) + 2;
   for (i=0; i<len; i++)
@@ -508,7 +561,8 @@ int main(int argc, char * argv [])
   /*
    * process command line arguments
    */
-  while ((ch = getopt(argc,argv,"?Ab:B:c:C:DeE:Fi:l:np:OP:qstU:uvVx:yY:")) != -1) {
+  while ((ch = getopt_long(argc,argv,"?Ab:B:c:C:DeE:Fi:l:np:OP:qstU:uvVx:yY:",
+                           long_options, NULL)) != -1) {
 
     switch (ch) {
       case 'b': /* override default programmer baud rate */
@@ -655,6 +709,7 @@ int main(int argc, char * argv [])
           exit(1);
         }
         ladd(updates, upd);
+        ladd(update_specs, optarg);
         break;
 
       case 'v':
@@ -679,6 +734,46 @@ int main(int argc, char * argv [])
                 progname);
         break;
 
+      case OPT_PROGRESS_FD: /* machine-readable progress */
+        progress_fd = strtol(optarg, &e, 0);
+        if ((e == optarg) || (*e != 0) || progress_fd < 0) {
+          avrdude_message(MSG_INFO, "%s: invalid file descriptor specified '%s'\n",
+                  progname, optarg);
+          exit(1);
+        }
+        break;
+
+      case OPT_PROGRESS_HZ:
+        progress_event_hz = strtol(optarg, &e, 0);
+        if ((e == optarg) || (*e != 0) || progress_event_hz < 0) {
+          avrdude_message(MSG_INFO, "%s: invalid progress event rate specified '%s'\n",
+                  progname, optarg);
+          exit(1);
+        }
+        break;
+
+      case OPT_TRACE: /* session timeline */
+        if (trace_open(optarg) < 0)
+          exit(1);
+        trace_begin("avrdude");
+        break;
+
+      case OPT_BASE: /* delta programming */
+        update_base = optarg;
+        break;
+
+      case OPT_DAEMON: /* serve requests on a socket */
+        daemon_socket = optarg;
+        break;
+
+      case OPT_CONNECT: /* forward requests to a daemon */
+        connect_socket = optarg;
+        break;
+
+      case OPT_STOP:
+        stop_daemon = 1;
+        break;
+
       case '?': /* help */
         usage();
         exit(0);
@@ -703,6 +798,23 @@ int main(int argc, char * argv [])
     }
   }
 
+  if (stop_daemon && !connect_socket) {
+    avrdude_message(MSG_INFO, "%s: --stop requires --connect\n", progname);
+    exit(1);
+  }
+
+  if (connect_socket) {
+    /*
+     * the daemon has the programmer open: hand the operations over to it
+     */
+    if (daemon_socket) {
+      avrdude_message(MSG_INFO, "%s: --daemon and --connect are mutually exclusive\n", progname);
+      exit(1);
+    }
+    rc = daemon_client(connect_socket, update_specs, terminal, uflags, erase, stop_daemon);
+    exit(rc? 1: 0);
+  }
+
   /* search for system configuration file unless -C conffile was given */
   if (strlen(sys_config) == 0) {
     /*
@@ -822,6 +934,12 @@ int main(int argc, char * argv [])
   if (quell_progress == 0)
     terminal_setup_update_progress();
 
+  if (progress_fd >= 0 && terminal_setup_progress_fd(progress_fd) < 0) {
+    avrdude_message(MSG_INFO, "%s: cannot write progress events to file descriptor %d: %s\n",
+      progname, progress_fd, strerror(errno));
+    exit(1);
+  }
+
   /*
    * Print out an identifying string so folks can tell what version
    * they are running
@@ -833,6 +951,7 @@ int main(int argc, char * argv [])
   avrdude_message(MSG_NOTICE, "%sSystem wide configuration file is \"%s\"\n",
             progbuf, sys_config);
 
+  trace_begin("read config");
   rc = read_config(sys_config);
   if (rc) {
     avrdude_message(MSG_INFO, "%s: error reading system wide configuration file \"%s\"\n",
@@ -878,6 +997,8 @@ int main(int argc, char * argv [])
     }
   }
 
+  trace_end();
+
   // set bitclock from configuration files unless changed by command line
   if (default_bitclock > 0 && bitclock == 0.0) {
     bitclock = default_bitclock;
@@ -1038,6 +1159,8 @@ int main(int argc, char * argv [])
    * view to exit before programming.
    */
   int doexit = 0;
+  if (update_expand_all(p, updates) < 0)
+    exit(1);
   for (ln=lfirst(updates); ln; ln=lnext(ln)) {
     upd = ldata(ln);
     if (upd->memtype == NULL) {
@@ -1093,7 +1216,9 @@ int main(int argc, char * argv [])
     pgm->ispdelay = ispdelay;
   }
 
+  trace_begin("open");
   rc = pgm->open(pgm, port);
+  trace_end();
   if (rc < 0) {
     avrdude_message(MSG_INFO,
                     "%s: opening programmer \"%s\" on port \"%s\" failed\n",
@@ -1152,7 +1277,9 @@ int main(int argc, char * argv [])
   /*
    * initialize the chip in preparation for accepting commands
    */
+  trace_begin("initialize");
   init_ok = (rc = pgm->initialize(pgm, p)) >= 0;
+  trace_end();
   if (!init_ok) {
     avrdude_message(MSG_INFO, "%s: initialization failed, rc=%d\n", progname, rc);
     if (!ovsigck) {
@@ -1186,7 +1313,9 @@ int main(int argc, char * argv [])
   sig_again:
     usleep(waittime);
     if (init_ok) {
+      trace_begin("read signature");
       rc = avr_signature(pgm, p);
+      trace_end();
       if (rc != LIBAVRDUDE_SUCCESS) {
         if (rc == LIBAVRDUDE_SOFTFAIL && (p->prog_modes & PM_UPDI) && attempt < 1) {
           attempt++;
@@ -1309,7 +1438,22 @@ int main(int argc, char * argv [])
     }
   }
 
-  if (uflags & UF_AUTO_ERASE) {
+  if (update_base && erase) {
+    avrdude_message(MSG_INFO, "%s: conflicting -e and --base options specified\n", progname);
+    exitrc = 1;
+    goto main_exit;
+  }
+
+  if (update_base) {
+    // Delta programming must keep the pages that do not change
+    if (update_base_check(pgm, p, &uflags) < 0) {
+      exitrc = 1;
+      goto main_exit;
+    }
+    if (quell_progress < 2)
+      avrdude_message(MSG_INFO, "%s: NOTE: delta programming against base image %s, "
+                      "no chip erase is performed\n", progname, update_base);
+  } else if (uflags & UF_AUTO_ERASE) {
     if ((p->prog_modes & PM_PDI) && pgm->page_erase && lsize(updates) > 0) {
       if (quell_progress < 2) {
         avrdude_message(MSG_INFO, "%s: NOTE: Programmer supports page erase for Xmega devices.\n"
@@ -1352,7 +1496,9 @@ int main(int argc, char * argv [])
     } else {
       if (quell_progress < 2)
       	avrdude_message(MSG_INFO, "%s: erasing chip\n", progname);
+      trace_begin("chip erase");
       exitrc = avr_chip_erase(pgm, p);
+      trace_end();
       if(exitrc) goto main_exit;
     }
   }
@@ -1373,13 +1519,16 @@ int main(int argc, char * argv [])
   }
 
 
-  for (ln=lfirst(updates); ln; ln=lnext(ln)) {
-    upd = ldata(ln);
-    rc = do_op(pgm, p, upd, uflags);
-    if (rc && rc != LIBAVRDUDE_SOFTFAIL) {
+  rc = do_ops(pgm, p, updates, uflags);
+  if (rc && rc != LIBAVRDUDE_SOFTFAIL)
+    exitrc = 1;
+
+  if (daemon_socket && exitrc == 0) {
+    /*
+     * keep the programmer open and serve requests until asked to stop
+     */
+    if (daemon_serve(pgm, p, daemon_socket) < 0)
       exitrc = 1;
-      break;
-    }
   }
 
 main_exit:
@@ -1389,6 +1538,7 @@ main_exit:
    */
 
   if (is_open) {
+    trace_begin("close");
     pgm->powerdown(pgm);
 
     pgm->disable(pgm);
@@ -1396,6 +1546,7 @@ main_exit:
     pgm->rdy_led(pgm, OFF);
 
     pgm->close(pgm);
+    trace_end();
   }
 
   if (quell_progress < 2) {
@@ -45,6 +45,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/time.h>
 #include "avrdude.h"
 #include "micronucleus.h"
 #include "usbdevs.h"
@@ -73,6 +74,7 @@
 #define MICRONUCLEUS_CMD_START 4
 
 #define MICRONUCLEUS_DEFAULT_TIMEOUT 500
+#define MICRONUCLEUS_POLL_TIMEOUT 10    // milliseconds per readiness poll
 #define MICRONUCLEUS_MAX_MAJOR_VERSION 2
 
 #define PDATA(pgm) ((pdata_t*)(pgm->cookie))
@@ -102,6 +104,9 @@ typedef struct pdata
     uint16_t user_reset_vector; // reset vector of user program
     bool write_last_page;       // last page already programmed
     bool start_program;         // require start after flash
+    // Statistics
+    uint32_t pages_written;
+    uint32_t write_wait_us;     // time spent waiting for page writes to complete
 } pdata_t;
 
 //-----------------------------------------------------------------------------
@@ -111,6 +116,13 @@ static void delay_ms(uint32_t duration)
     usleep(duration * 1000);
 }
 
+static uint32_t elapsed_us(const struct timeval* start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec);
+}
+
 static int micronucleus_check_connection(pdata_t* pdata)
 {
     if (pdata->major_version >= 2)
@@ -139,6 +151,41 @@ static int micronucleus_check_connection(pdata_t* pdata)
     }
 }
 
+// The bootloader handles one request at a time and does not answer USB
+// while it is writing a page, so the first request it answers after a
+// page transfer means the page is done. Poll with short timeouts and a
+// growing pause instead of always sleeping the worst-case write time;
+// give up polling after twice that time and let the next request fail.
+static void micronucleus_wait_page_written(pdata_t* pdata)
+{
+    struct timeval start;
+    uint32_t pause_us = 500;
+    uint32_t limit_us = pdata->write_sleep * 2000;
+    uint8_t buffer[6];
+
+    gettimeofday(&start, NULL);
+    while (usb_control_msg(
+        pdata->usb_handle,
+        USB_ENDPOINT_IN | USB_TYPE_VENDOR | USB_RECIP_DEVICE,
+        MICRONUCLEUS_CMD_INFO,
+        0, 0,
+        (char*)buffer, sizeof(buffer),
+        MICRONUCLEUS_POLL_TIMEOUT) < 0)
+    {
+        if (elapsed_us(&start) >= limit_us)
+        {
+            avrdude_message(MSG_DEBUG, "%s: No answer from device after page write\n", progname);
+            break;
+        }
+        usleep(pause_us);
+        if (pause_us < 4000)
+            pause_us *= 2;
+    }
+
+    pdata->write_wait_us += elapsed_us(&start);
+    pdata->pages_written++;
+}
+
 static bool micronucleus_is_device_responsive(pdata_t* pdata, struct usb_device* device)
 {
     pdata->usb_handle = usb_open(device);
@@ -521,7 +568,7 @@ static int micronucleus_write_page(pdata_t* pdata, uint32_t address, uint8_t* bu
         return result;
     }
 
-    delay_ms(pdata->write_sleep);
+    micronucleus_wait_page_written(pdata);
 
     return 0;
 }
@@ -812,6 +859,15 @@ static void micronucleus_close(PROGRAMMER* pgm)
     avrdude_message(MSG_DEBUG, "%s: micronucleus_close()\n", progname);
 
     pdata_t* pdata = PDATA(pgm);
+    if (pdata->pages_written > 0)
+    {
+        avrdude_message(MSG_NOTICE, "%s: Waited %u ms for %u page writes (fixed write sleep: %u ms)\n",
+            progname, pdata->write_wait_us / 1000, pdata->pages_written,
+            pdata->pages_written * pdata->write_sleep);
+        pdata->pages_written = 0;
+        pdata->write_wait_us = 0;
+    }
+
     if (pdata->usb_handle != NULL)
     {
         usb_close(pdata->usb_handle);
@@ -377,6 +377,7 @@ void par_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->cmd_tpi_block  = bitbang_cmd_tpi_block;
   pgm->spi            = bitbang_spi;
   pgm->open           = par_open;
   pgm->close          = par_close;
@@ -386,6 +387,8 @@ void par_initpgm(PROGRAMMER *pgm) {
   pgm->parseexitspecs = par_parseexitspecs;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = bitbang_paged_load;
+  pgm->paged_write    = bitbang_paged_write;
 }
 
 #else  /* !HAVE_PARPORT */
@@ -86,6 +86,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->initpgm = NULL;
   pgm->lineno = 0;
   pgm->baudrate = 0;
+  pgm->max_paged_xfer = 0;
 
   // Clear pin array
   for(int i=0; i<N_PINS; i++) {
@@ -132,6 +133,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->unlock         = NULL;
   pgm->cmd            = NULL;
   pgm->cmd_tpi        = NULL;
+  pgm->cmd_tpi_block  = NULL;
   pgm->spi            = NULL;
   pgm->paged_write    = NULL;
   pgm->paged_load     = NULL;
@@ -139,6 +141,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->write_setup    = NULL;
   pgm->read_sig_bytes = NULL;
   pgm->read_sib       = NULL;
+  pgm->verify_crc     = NULL;
   pgm->print_parms    = NULL;
   pgm->set_vtarget    = NULL;
   pgm->set_varef      = NULL;
@@ -0,0 +1,95 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2022 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Serial receive timeout derived from the round-trip time of the link
+ *
+ * void serial_rtt_sample(long usecs);
+ *
+ * long serial_rtt_timeout(int attempt);
+ *
+ * The sync functions of the programmers time their request/answer
+ * exchanges and pass them to serial_rtt_sample().  This keeps a
+ * smoothed round-trip time and sets serial_recv_timeout to a multiple
+ * of it, clamped to [SERIAL_RTT_FLOOR, SERIAL_RTT_CEILING], so that
+ * fast links give up early on a lost answer and slow links, eg,
+ * Bluetooth, are given enough time.  The floor leaves room for
+ * commands that take a while before they are answered, such as writing
+ * a page of EEPROM.  A timeout that a programmer has set below the
+ * floor on purpose is left alone.
+ *
+ * serial_rtt_timeout() returns the receive timeout for the given sync
+ * attempt (counting from 0): a few round-trip times, doubling with
+ * every attempt, but never more than serial_recv_timeout.  Without a
+ * round-trip time yet it returns serial_recv_timeout.
+ */
+
+#include "ac_cfg.h"
+
+#include <stdio.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#define SERIAL_RTT_FACTOR  20       // Timeout in round-trip times
+#define SERIAL_RTT_FLOOR   2000     // ms
+#define SERIAL_RTT_CEILING 20000    // ms
+#define SERIAL_RTT_PROBE   20       // Shortest sync attempt timeout, ms
+
+static long srtt;                   // Smoothed round-trip time in us, 0 if unknown
+
+void serial_rtt_sample(long usecs) {
+  long timeout;
+
+  if(usecs <= 0)
+    usecs = 1;
+
+  // Same smoothing as TCP: the first sample counts fully, later ones by 1/8
+  srtt = srtt? srtt + (usecs - srtt)/8: usecs;
+
+  if(serial_recv_timeout < SERIAL_RTT_FLOOR)
+    return;
+
+  timeout = SERIAL_RTT_FACTOR * (srtt/1000 + 1);
+  if(timeout < SERIAL_RTT_FLOOR)
+    timeout = SERIAL_RTT_FLOOR;
+  if(timeout > SERIAL_RTT_CEILING)
+    timeout = SERIAL_RTT_CEILING;
+
+  if(timeout != serial_recv_timeout)
+    avrdude_message(MSG_NOTICE2, "%s: round-trip time %ld us, receive timeout %ld ms\n",
+      progname, srtt, timeout);
+  serial_recv_timeout = timeout;
+}
+
+long serial_rtt_timeout(int attempt) {
+  long timeout;
+
+  if(srtt == 0)
+    return serial_recv_timeout;
+
+  timeout = 4 * (srtt/1000 + 1);
+  if(timeout < SERIAL_RTT_PROBE)
+    timeout = SERIAL_RTT_PROBE;
+  while(attempt-- > 0 && timeout < serial_recv_timeout)
+    timeout *= 2;
+
+  return timeout < serial_recv_timeout? timeout: serial_recv_timeout;
+}
@@ -70,10 +70,37 @@ static char *serpins[DB9PINS + 1] =
   { "NONE", "CD", "RXD", "TXD", "DTR", "GND", "DSR", "RTS", "CTS", "RI" };
 #endif
 
+/*
+  Shadow copy of the modem control word.  MOSI changes and falling SCK
+  edges are collected in it and written with a single TIOCMSET right
+  before SCK rises, an input is sampled or any other pin changes, so
+  one SPI bit costs three ioctls rather than seven.
+*/
+static unsigned int ctlshadow;
+static int ctldirty;
+
+static int serbb_flush(const PROGRAMMER *pgm) {
+  if (!ctldirty)
+    return 0;
+
+  ctldirty = 0;
+  if (ioctl(pgm->fd.ifd, TIOCMSET, &ctlshadow) < 0) {
+    perror("ioctl(\"TIOCMSET\")");
+    return -1;
+  }
+
+  return 0;
+}
+
 static int serbb_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
   unsigned int	ctl;
   int           r;
   int pin = pgm->pinno[pinfunc]; // get its value
+  int coalesce;
+
+  /* Defer changes that may happen together with the next one */
+  coalesce = pgm->ispdelay <= 1 &&
+    (pinfunc == PIN_AVR_MOSI || (pinfunc == PIN_AVR_SCK && !value));
 
   if (pin & PIN_INVERSE)
   {
@@ -91,6 +118,8 @@ static int serbb_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
   switch ( pin )
   {
     case 3:  /* txd */
+	     if (serbb_flush(pgm) < 0)
+	       return -1;
 	     r = ioctl(pgm->fd.ifd, value ? TIOCSBRK : TIOCCBRK, 0);
 	     if (r < 0) {
 	       perror("ioctl(\"TIOCxBRK\")");
@@ -100,20 +129,20 @@ static int serbb_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
 
     case 4:  /* dtr */
     case 7:  /* rts */
-             r = ioctl(pgm->fd.ifd, TIOCMGET, &ctl);
- 	     if (r < 0) {
-	       perror("ioctl(\"TIOCMGET\")");
-	       return -1;
- 	     }
+             /* Earlier changes go out first, eg, MOSI before SCK rises */
+             if (!coalesce && serbb_flush(pgm) < 0)
+               return -1;
+             ctl = ctlshadow;
              if ( value )
                ctl |= serregbits[pin];
              else
                ctl &= ~(serregbits[pin]);
-	     r = ioctl(pgm->fd.ifd, TIOCMSET, &ctl);
- 	     if (r < 0) {
-	       perror("ioctl(\"TIOCMSET\")");
-	       return -1;
- 	     }
+             if (ctl != ctlshadow) {
+               ctlshadow = ctl;
+               ctldirty = 1;
+             }
+             if (!coalesce && serbb_flush(pgm) < 0)
+               return -1;
              break;
 
     default: /* impossible */
@@ -151,6 +180,8 @@ static int serbb_getpin(const PROGRAMMER *pgm, int pinfunc) {
     case 6:  /* dsr */
     case 8:  /* cts */
     case 9:  /* ri  */
+             if (serbb_flush(pgm) < 0)
+               return -1;
              r = ioctl(pgm->fd.ifd, TIOCMGET, &ctl);
  	     if (r < 0) {
 	       perror("ioctl(\"TIOCMGET\")");
@@ -264,6 +295,14 @@ static int serbb_open(PROGRAMMER *pgm, const char *port) {
       return(-1);
     }
 
+  /* The outputs are only read back once, into the shadow copy */
+  r = ioctl(pgm->fd.ifd, TIOCMGET, &ctlshadow);
+  if (r < 0) {
+    perror("ioctl(\"TIOCMGET\")");
+    return(-1);
+  }
+  ctldirty = 0;
+
   return(0);
 }
 
@@ -298,6 +337,7 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->cmd_tpi_block  = bitbang_cmd_tpi_block;
   pgm->open           = serbb_open;
   pgm->close          = serbb_close;
   pgm->setpin         = serbb_setpin;
@@ -305,6 +345,8 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->highpulsepin   = serbb_highpulsepin;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = bitbang_paged_load;
+  pgm->paged_write    = bitbang_paged_write;
 }
 
 #endif  /* WIN32 */
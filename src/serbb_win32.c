@@ -344,6 +344,7 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->cmd_tpi_block  = bitbang_cmd_tpi_block;
   pgm->open           = serbb_open;
   pgm->close          = serbb_close;
   pgm->setpin         = serbb_setpin;
@@ -351,6 +352,8 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->highpulsepin   = serbb_highpulsepin;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = bitbang_paged_load;
+  pgm->paged_write    = bitbang_paged_write;
 }
 
 #endif  /* WIN32 */
@@ -176,6 +176,11 @@ static int serialupdi_decode_sib(const PROGRAMMER *pgm, updi_sib_info *sib_info)
 
 static void serialupdi_close(PROGRAMMER * pgm)
 {
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+
+  avrdude_message(MSG_NOTICE, "%s: NVM ready waits: %lu, status polls: %lu, slept %lu ms\n",
+                  progname, timing->waits, timing->polls, timing->slept_us/1000);
+
   avrdude_message(MSG_INFO, "%s: Leaving NVM programming mode\n", progname);
 
   if (serialupdi_leave_progmode(pgm) < 0) {
@@ -569,6 +574,136 @@ static int serialupdi_write_userrow(const PROGRAMMER *pgm, const AVRPART *p, con
   return 0;
 }
 
+/*
+ * Baud rates tried by -x autobaud, in ascending order, above the
+ * initial rate given by -b (or 115200)
+ */
+static const long serialupdi_baud_ladder[] = {
+  230400, 345600, 460800, 500000, 921600,
+};
+
+/*
+ * The UPDI can sample a UART running at up to about fUPDI/18, so
+ * select the slowest UPDI clock that can keep up with a given baud
+ * rate.
+ */
+static uint8_t serialupdi_clksel(long baudrate) {
+  if (baudrate <= 225000)
+    return UPDI_ASI_CTRLA_UPDICLKSEL_4MHZ;
+  if (baudrate <= 450000)
+    return UPDI_ASI_CTRLA_UPDICLKSEL_8MHZ;
+  return UPDI_ASI_CTRLA_UPDICLKSEL_16MHZ;
+}
+
+static int serialupdi_set_link_speed(const PROGRAMMER *pgm, long baudrate) {
+  uint8_t clksel = serialupdi_clksel(baudrate);
+
+  /* Raise the UPDI clock while still talking at the old rate */
+  if (updi_write_cs(pgm, UPDI_ASI_CTRLA, clksel) < 0) {
+    return -1;
+  }
+
+  return updi_link_set_baudrate(pgm, baudrate);
+}
+
+/*
+ * Check the link at the current speed: STATUSA must read back as
+ * before, and a burst of ld_ptr_inc reads must return the reference
+ * data read at the initial rate.
+ */
+static int serialupdi_check_link_speed(const PROGRAMMER *pgm, uint8_t statusa,
+                                       uint32_t address, const uint8_t *reference, uint16_t size) {
+  uint8_t value, buffer[32];
+
+  if (updi_read_cs(pgm, UPDI_CS_STATUSA, &value) < 0 || value != statusa) {
+    return -1;
+  }
+
+  if (updi_read_data(pgm, address, buffer, size) < 0 || memcmp(buffer, reference, size) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Step the link speed up through serialupdi_baud_ladder, raising the
+ * UPDI clock as required, and settle on the fastest rate that passes
+ * serialupdi_check_link_speed().  A rate found by a previous run on
+ * the same port is tried first.
+ */
+static int serialupdi_autobaud(const PROGRAMMER *pgm, const AVRPART *p) {
+  const long base = updi_get_baudrate(pgm);
+  long good = base, cached;
+  uint8_t statusa, reference[32];
+  uint16_t size;
+  AVRMEM *mem;
+  size_t i;
+
+  if ((mem = avr_locate_mem(p, "prodsig")) == NULL &&
+      (mem = avr_locate_mem(p, "signature")) == NULL) {
+    avrdude_message(MSG_INFO, "%s: No signature memory to verify the link speed with, "
+                    "keeping %ld baud\n", progname, base);
+    return 0;
+  }
+  size = mem->size < (int) sizeof(reference)? mem->size: (int) sizeof(reference);
+
+  if (updi_read_cs(pgm, UPDI_CS_STATUSA, &statusa) < 0 ||
+      updi_read_data(pgm, mem->offset, reference, size) < 0) {
+    avrdude_message(MSG_INFO, "%s: Cannot read reference data, keeping %ld baud\n",
+                    progname, base);
+    return 0;
+  }
+
+  cached = serial_baud_cache_get(pgm->port);
+  if (cached > base) {
+    if (serialupdi_set_link_speed(pgm, cached) == 0 &&
+        serialupdi_check_link_speed(pgm, statusa, mem->offset, reference, size) == 0) {
+      avrdude_message(MSG_INFO, "%s: Using cached link speed of %ld baud\n", progname, cached);
+      return 0;
+    }
+    avrdude_message(MSG_NOTICE, "%s: Cached link speed of %ld baud failed\n", progname, cached);
+    if (updi_link_set_baudrate(pgm, base) < 0 || updi_link_init(pgm) < 0) {
+      return -1;
+    }
+  }
+
+  for (i = 0; i < sizeof(serialupdi_baud_ladder)/sizeof(*serialupdi_baud_ladder); i++) {
+    long baudrate = serialupdi_baud_ladder[i];
+
+    if (baudrate <= good) {
+      continue;
+    }
+
+    avrdude_message(MSG_NOTICE2, "%s: Trying link speed of %ld baud\n", progname, baudrate);
+    if (serialupdi_set_link_speed(pgm, baudrate) < 0 ||
+        serialupdi_check_link_speed(pgm, statusa, mem->offset, reference, size) < 0) {
+      avrdude_message(MSG_NOTICE, "%s: Link speed of %ld baud failed\n", progname, baudrate);
+      break;
+    }
+    good = baudrate;
+  }
+
+  /*
+   * Go back to the last good rate.  If the UPDI lost track, re-initialising
+   * the link takes it back to the initial rate via a double break.
+   */
+  if (updi_get_baudrate(pgm) != good) {
+    if (serialupdi_set_link_speed(pgm, good) < 0 ||
+        serialupdi_check_link_speed(pgm, statusa, mem->offset, reference, size) < 0) {
+      if (updi_link_set_baudrate(pgm, good) < 0 || updi_link_init(pgm) < 0) {
+        return -1;
+      }
+    }
+  }
+
+  good = updi_get_baudrate(pgm);
+  serial_baud_cache_put(pgm->port, good > base? good: 0);
+  avrdude_message(MSG_INFO, "%s: Link speed set to %ld baud\n", progname, good);
+
+  return 0;
+}
+
 static int serialupdi_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
   uint8_t value;
   uint8_t reset_link_required=0;
@@ -645,6 +780,11 @@ static int serialupdi_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
     return -1;
   }
 
+  if (updi_get_autobaud(pgm) && serialupdi_autobaud(pgm, p) < 0) {
+    avrdude_message(MSG_INFO, "%s: UPDI link speed negotiation failed\n", progname);
+    return -1;
+  }
+
   avrdude_message(MSG_INFO, "%s: Entering NVM programming mode\n", progname);
     /* try, but ignore failure */
   serialupdi_enter_progmode(pgm);
@@ -718,18 +858,19 @@ static int serialupdi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
   if (n_bytes > m->readsize) {
     unsigned int read_offset = addr;
     unsigned int remaining_bytes = n_bytes;
+    unsigned int chunk;
     int read_bytes = 0;
     int rc;
     while (remaining_bytes > 0) {
-      rc = updi_read_data(pgm, m->offset + read_offset, m->buf + read_offset, 
-                          remaining_bytes > m->readsize ? m->readsize : remaining_bytes);
+      chunk = remaining_bytes > m->readsize ? m->readsize : remaining_bytes;
+      rc = updi_read_data(pgm, m->offset + read_offset, m->buf + read_offset, chunk);
       if (rc < 0) {
         avrdude_message(MSG_INFO, "%s: Paged load operation failed\n", progname);
         return rc;
       } else {
         read_bytes+=rc;
-        read_offset+=m->readsize;
-        remaining_bytes-=m->readsize;
+        read_offset+=chunk;
+        remaining_bytes-=chunk;
       }
     }
     return read_bytes;
@@ -921,6 +1062,21 @@ static int serialupdi_read_sib(const PROGRAMMER *pgm, const AVRPART *p, char *si
   return 0;
 }
 
+static int serialupdi_read_data(const PROGRAMMER *pgm, unsigned long addr, unsigned char *value) {
+  return updi_read_byte(pgm, addr, value);
+}
+
+static int serialupdi_write_data(const PROGRAMMER *pgm, unsigned long addr, unsigned char value) {
+  return updi_write_byte(pgm, addr, value);
+}
+
+static int serialupdi_verify_crc(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  if (!updi_get_crc_verify(pgm))
+    return 0;
+
+  return avr_crcscan_verify(pgm, p, m, serialupdi_read_data, serialupdi_write_data);
+}
+
 static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
   LNODEID ln;
   const char *extended_param;
@@ -942,6 +1098,16 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
       continue;
     }
 
+    if (strcmp(extended_param, "autobaud") == 0) {
+      updi_set_autobaud(pgm, 1);
+      continue;
+    }
+
+    if (strcmp(extended_param, "crcverify") == 0) {
+      updi_set_crc_verify(pgm, 1);
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: serialupdi_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
     rv = -1;
@@ -978,11 +1144,12 @@ void serialupdi_initpgm(PROGRAMMER *pgm) {
   pgm->paged_write    = serialupdi_paged_write;
   pgm->read_sig_bytes = serialupdi_read_signature;
   pgm->read_sib       = serialupdi_read_sib;
+  pgm->verify_crc     = serialupdi_verify_crc;
   pgm->paged_load     = serialupdi_paged_load;
   pgm->page_erase     = serialupdi_page_erase;
   pgm->setup          = serialupdi_setup;
   pgm->teardown       = serialupdi_teardown;
-
+  pgm->max_paged_xfer = 1024;
 }
 
 const char serialupdi_desc[] = "Driver for SerialUPDI programmers";
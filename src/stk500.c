@@ -35,6 +35,7 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -77,6 +78,10 @@ int stk500_getsync(const PROGRAMMER *pgm) {
   unsigned char buf[32], resp[32];
   int attempt;
   int max_sync_attempts;
+  long timeout = serial_recv_timeout;
+  struct timeval tv0, tv1;
+
+  trace_instant("getsync");
 
   buf[0] = Cmnd_STK_GET_SYNC;
   buf[1] = Sync_CRC_EOP;
@@ -105,6 +110,9 @@ int stk500_getsync(const PROGRAMMER *pgm) {
       stk500_drain(pgm, 0);
     }
 
+    // Give up on a lost answer after a few round-trip times once these are known
+    serial_recv_timeout = serial_rtt_timeout(attempt);
+    gettimeofday(&tv0, NULL);
     stk500_send(pgm, buf, 2);
     resp[0] = 0;
     if(stk500_recv(pgm, resp, 1) >= 0 && resp[0] == Resp_STK_INSYNC)
@@ -114,10 +122,12 @@ int stk500_getsync(const PROGRAMMER *pgm) {
                     progname, attempt + 1, max_sync_attempts, resp[0]);
   }
   if (attempt == max_sync_attempts) {
+    serial_recv_timeout = timeout;
     stk500_drain(pgm, 0);
     return -1;
   }
 
+  serial_recv_timeout = timeout;
   if (stk500_recv(pgm, resp, 1) < 0)
     return -1;
   if (resp[0] != Resp_STK_OK) {
@@ -127,6 +137,9 @@ int stk500_getsync(const PROGRAMMER *pgm) {
     return -1;
   }
 
+  gettimeofday(&tv1, NULL);
+  serial_rtt_sample((tv1.tv_sec - tv0.tv_sec)*1000000L + tv1.tv_usec - tv0.tv_usec);
+
   return 0;
 }
 
@@ -609,6 +622,11 @@ static int stk500_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
        continue;
      }
 
+     if (strcmp(extended_param, "autobaud") == 0 && strcmp(pgm->type, "Arduino") == 0) {
+       PDATA(pgm)->autobaud = 1;
+       continue;
+     }
+
      avrdude_message(MSG_INFO, "%s: stk500_parseextparms(): invalid extended parameter '%s'\n",
                      progname, extended_param);
      rv = -1;
@@ -41,7 +41,9 @@ int stk500_drain(const PROGRAMMER *pgm, int display);
 struct pdata {
   unsigned char ext_addr_byte;  // Record ext-addr byte set in the target device (if used)
   int retry_attempts;           // Number of connection attempts provided by the user
+  int autobaud;                 // Search for the bootloader's baud rate (arduino)
   int xbeeResetPin;             // Piggy back variable used by xbee programmmer
+  int xbeeWindow;               // Requested xbee transmit window, 0 = stop-and-wait
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
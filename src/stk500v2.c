@@ -728,6 +728,8 @@ int stk500v2_getsync(const PROGRAMMER *pgm) {
   int tries = 0;
   unsigned char buf[1], resp[32];
   int status;
+  long timeout = serial_recv_timeout;
+  struct timeval tv0, tv1;
 
   DEBUG("STK500V2: stk500v2_getsync()\n");
 
@@ -735,15 +737,22 @@ int stk500v2_getsync(const PROGRAMMER *pgm) {
       PDATA(pgm)->pgmtype == PGMTYPE_JTAGICE3)
     return 0;
 
+  trace_instant("getsync");
+
 retry:
   tries++;
 
+  // back off from a few round-trip times once these are known
+  serial_recv_timeout = serial_rtt_timeout(tries - 1);
+  gettimeofday(&tv0, NULL);
+
   // send the sync command and see if we can get there
   buf[0] = CMD_SIGN_ON;
   stk500v2_send(pgm, buf, 1);
 
   // try to get the response back and see where we got
   status = stk500v2_recv(pgm, resp, sizeof(resp));
+  serial_recv_timeout = timeout;
 
   // if we got bytes returned, check to see what came back
   if (status > 0) {
@@ -772,6 +781,8 @@ retry:
       }
       avrdude_message(MSG_DEBUG, "%s: stk500v2_getsync(): found %s programmer\n",
                         progname, pgmname[PDATA(pgm)->pgmtype]);
+      gettimeofday(&tv1, NULL);
+      serial_rtt_sample((tv1.tv_sec - tv0.tv_sec)*1000000L + tv1.tv_usec - tv0.tv_usec);
       return 0;
     } else {
       if (tries > RETRIES) {
@@ -4340,6 +4351,7 @@ void stk500v2_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500pp_desc[] = "Atmel STK500 V2 in parallel programming mode";
@@ -4374,6 +4386,7 @@ void stk500pp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500hvsp_desc[] = "Atmel STK500 V2 in high-voltage serial programming mode";
@@ -4408,6 +4421,7 @@ void stk500hvsp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500v2_jtagmkII_desc[] = "Atmel JTAG ICE mkII in ISP mode";
@@ -4442,6 +4456,7 @@ void stk500v2_jtagmkII_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_jtagmkII_setup;
   pgm->teardown       = stk500v2_jtagmkII_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500v2_dragon_isp_desc[] = "Atmel AVR Dragon in ISP mode";
@@ -4475,6 +4490,7 @@ void stk500v2_dragon_isp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_jtagmkII_setup;
   pgm->teardown       = stk500v2_jtagmkII_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500v2_dragon_pp_desc[] = "Atmel AVR Dragon in PP mode";
@@ -4509,6 +4525,7 @@ void stk500v2_dragon_pp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_jtagmkII_setup;
   pgm->teardown       = stk500v2_jtagmkII_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500v2_dragon_hvsp_desc[] = "Atmel AVR Dragon in HVSP mode";
@@ -4543,6 +4560,7 @@ void stk500v2_dragon_hvsp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_jtagmkII_setup;
   pgm->teardown       = stk500v2_jtagmkII_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk600_desc[] = "Atmel STK600";
@@ -4580,6 +4598,7 @@ void stk600_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk600pp_desc[] = "Atmel STK600 in parallel programming mode";
@@ -4614,6 +4633,7 @@ void stk600pp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk600hvsp_desc[] = "Atmel STK600 in high-voltage serial programming mode";
@@ -4648,6 +4668,7 @@ void stk600hvsp_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_setup;
   pgm->teardown       = stk500v2_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 }
 
 const char stk500v2_jtag3_desc[] = "Atmel JTAGICE3 in ISP mode";
@@ -4682,6 +4703,7 @@ void stk500v2_jtag3_initpgm(PROGRAMMER *pgm) {
   pgm->setup          = stk500v2_jtag3_setup;
   pgm->teardown       = stk500v2_jtag3_teardown;
   pgm->page_size      = 256;
+  pgm->max_paged_xfer = 1024;
 
   if (strcmp(ldata(lfirst(pgm->id)), "powerdebugger_isp") == 0)
     pgm->set_vtarget  = jtag3_set_vtarget;
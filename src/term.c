@@ -1299,49 +1299,61 @@ char * terminal_get_input(const char *prompt)
 }
 
 
-int terminal_mode(PROGRAMMER * pgm, struct avrpart * p)
+/*
+ * Execute one terminal command line; returns > 0 if the command asks to
+ * quit, < 0 on error and 0 otherwise
+ */
+int terminal_line(PROGRAMMER * pgm, struct avrpart * p, char * line)
 {
-  char  * cmdbuf;
   char  * q;
   int     rc;
   int     argc;
   char ** argv;
 
-  rc = 0;
-  while ((cmdbuf = terminal_get_input("avrdude> ")) != NULL) {
-    /*
-     * find the start of the command, skipping any white space
-     */
-    q = cmdbuf;
-    while (*q && isspace((unsigned char) *q))
-      q++;
-
-    /* skip blank lines and comments */
-    if (!*q || (*q == '#'))
-      continue;
-
-    /* tokenize command line */
-    argc = tokenize(q, &argv);
-    if (argc < 0) {
-      free(cmdbuf);
-      return argc;
-    }
+  /*
+   * find the start of the command, skipping any white space
+   */
+  q = line;
+  while (*q && isspace((unsigned char) *q))
+    q++;
+
+  /* skip blank lines and comments */
+  if (!*q || (*q == '#'))
+    return 0;
+
+  /* tokenize command line */
+  argc = tokenize(q, &argv);
+  if (argc < 0)
+    return argc;
 
 #if !defined(HAVE_LIBREADLINE) || defined(WIN32) || defined(__APPLE__)
-    fprintf(stdout, ">>> ");
-    for (int i=0; i<argc; i++)
-      fprintf(stdout, "%s ", argv[i]);
-    fprintf(stdout, "\n");
+  fprintf(stdout, ">>> ");
+  for (int i=0; i<argc; i++)
+    fprintf(stdout, "%s ", argv[i]);
+  fprintf(stdout, "\n");
 #endif
 
-    /* run the command */
-    rc = do_cmd(pgm, p, argc, argv);
-    free(argv);
+  /* run the command */
+  rc = do_cmd(pgm, p, argc, argv);
+  free(argv);
+
+  return rc;
+}
+
+
+int terminal_mode(PROGRAMMER * pgm, struct avrpart * p)
+{
+  char  * cmdbuf;
+  int     rc;
+
+  rc = 0;
+  while ((cmdbuf = terminal_get_input("avrdude> ")) != NULL) {
+    rc = terminal_line(pgm, p, cmdbuf);
+    free(cmdbuf);
     if (rc > 0) {
       rc = 0;
       break;
     }
-    free(cmdbuf);
   }
 
   pgm->flush_cache(pgm, p);
@@ -1436,6 +1448,30 @@ static void update_progress_no_tty(int percent, double etime, const char *hdr, i
   setvbuf(stderr, (char *) NULL, _IOLBF, 0);
 }
 
+static FILE *progress_fp;
+
+// Emit a progress event as one line of JSON
+static void progress_event_json(const PROGRESS_EVENT *ev) {
+  fprintf(progress_fp, "{\"phase\":\"%s\",\"memory\":", ev->phase? ev->phase: "");
+  if(ev->memory)
+    fprintf(progress_fp, "\"%s\"", ev->memory);
+  else
+    fprintf(progress_fp, "null");
+  fprintf(progress_fp, ",\"state\":\"%s\",\"done\":%ld,\"total\":%ld,"
+    "\"elapsed\":%.3f,\"rate\":%.1f,\"eta\":%.1f,\"retries\":%d}\n",
+    ev->state, ev->done, ev->total, ev->elapsed, ev->rate, ev->eta, ev->retries);
+  fflush(progress_fp);
+}
+
+// Send progress events as JSON lines to file descriptor fd
+int terminal_setup_progress_fd(int fd) {
+  if((progress_fp = fdopen(fd, "w")) == NULL)
+    return -1;
+
+  progress_event = progress_event_json;
+  return 0;
+}
+
 void terminal_setup_update_progress() {
   if (isatty (STDERR_FILENO))
     update_progress = update_progress_tty;
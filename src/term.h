@@ -33,8 +33,10 @@ typedef enum {
 } mode;
 
 int terminal_mode(PROGRAMMER * pgm, struct avrpart * p);
+int terminal_line(PROGRAMMER * pgm, struct avrpart * p, char * line);
 char * terminal_get_input(const char *prompt);
 void terminal_setup_update_progress();
+int terminal_setup_progress_fd(int fd);
 int terminal_message(const int msglvl, const char *format, ...);
 
 #ifdef __cplusplus
@@ -68,6 +68,43 @@ static const unsigned char tpi_skey[] = { 0x12, 0x89, 0xAB, 0x45, 0xCD, 0xD8, 0x
 
 static const unsigned char tpi_skey_cmd[] = { TPI_CMD_SKEY, 0xff, 0x88, 0xd8, 0xcd, 0x45, 0xab, 0x89, 0x12 };
 
+/*
+ * Not a TPI instruction: pseudo instruction for cmd_tpi_block()
+ * streams.  The following byte is a delay in units of
+ * TPI_BLOCK_DELAY_UNIT microseconds, during which the TPI link
+ * should be kept idle.  Opcode 0x00 is not used by TPI.
+ */
+#define TPI_BLOCK_DELAY		0x00
+#define TPI_BLOCK_DELAY_UNIT	16
+
+/*
+ * Length of the instruction starting with opcode op in a
+ * cmd_tpi_block() stream; *nres is set to the number of response
+ * bytes it produces.  Lets programmers walk a block and find the
+ * response slots without further information.
+ */
+static inline int tpi_insn_len(unsigned char op, int *nres) {
+  *nres = 0;
+  if (op == TPI_BLOCK_DELAY)
+    return 2;
+  if (op & 0x10) {                      /* SIN / SOUT */
+    if (op & 0x80)
+      return 2;
+    *nres = 1;
+    return 1;
+  }
+  switch (op & 0xf0) {
+  case TPI_CMD_SLD:                     /* SLD, SLD_PI */
+  case TPI_CMD_SLDCS:
+    *nres = 1;
+    return 1;
+  case TPI_CMD_SKEY:
+    return 1 + 8;
+  default:                              /* SST, SST_PI, SSTPR, SSTCS */
+    return 2;
+  }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,191 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2022 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Session timeline tracing in the Chrome trace-event format, viewable
+ * with chrome://tracing or Perfetto
+ *
+ * int trace_open(const char *filename);
+ *
+ * void trace_close(void);
+ *
+ * void trace_begin(const char *name);
+ *
+ * void trace_end(void);
+ *
+ * void trace_instant(const char *name);
+ *
+ * void trace_counter(const char *name, long value);
+ *
+ * trace_open() allocates the event buffer; until then all other calls
+ * return immediately.  trace_begin()/trace_end() pairs mark nested
+ * spans, trace_instant() a point in time and trace_counter() the value
+ * of a counter, eg, the number of bytes moved so far.  Events are only
+ * recorded in memory; trace_close() writes them to the file.  Events
+ * beyond the buffer size are dropped, but the ends of spans that were
+ * recorded are always kept so that the timeline stays well nested.
+ */
+
+#include "ac_cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#define TRACE_MAX_EVENTS 100000
+#define TRACE_MAX_DEPTH  64
+#define TRACE_NAME_LEN   40
+
+typedef struct {
+  char ph;                      // Event type: B, E, i or C
+  char name[TRACE_NAME_LEN];
+  long value;                   // Counter value
+  double ts;                    // Microseconds since trace_open()
+} trace_event;
+
+static trace_event *events;
+static int nevents, ndropped, depth;
+static char dropped[TRACE_MAX_DEPTH]; // Whether the begin of the span at this depth was dropped
+static char *trace_file;
+static double t0;
+
+static double trace_now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec*1e6 + tv.tv_usec;
+}
+
+static trace_event *trace_add(char ph, const char *name, int reserve) {
+  trace_event *ev;
+
+  // Keep room for the ends of all open spans
+  if(nevents + reserve >= TRACE_MAX_EVENTS) {
+    ndropped++;
+    return NULL;
+  }
+
+  ev = events + nevents++;
+  ev->ph = ph;
+  strncpy(ev->name, name? name: "", sizeof ev->name - 1);
+  ev->name[sizeof ev->name - 1] = 0;
+  for(char *s = ev->name; *s; s++)  // Keep the JSON output valid
+    if(*s == '"' || *s == '\\' || (unsigned char) *s < ' ')
+      *s = '_';
+  ev->value = 0;
+  ev->ts = trace_now() - t0;
+
+  return ev;
+}
+
+int trace_open(const char *filename) {
+  if(events)
+    return 0;
+
+  events = malloc(TRACE_MAX_EVENTS * sizeof *events);
+  trace_file = strdup(filename);
+  if(!events || !trace_file) {
+    avrdude_message(MSG_INFO, "%s: cannot allocate trace buffer\n", progname);
+    free(events);
+    free(trace_file);
+    events = NULL;
+    trace_file = NULL;
+    return -1;
+  }
+  nevents = ndropped = depth = 0;
+  t0 = trace_now();
+
+  return 0;
+}
+
+void trace_begin(const char *name) {
+  if(!events)
+    return;
+
+  if(depth < TRACE_MAX_DEPTH)
+    dropped[depth] = trace_add('B', name, depth + 1) == NULL;
+  depth++;
+}
+
+void trace_end(void) {
+  if(!events || depth == 0)
+    return;
+
+  depth--;
+  if(depth >= TRACE_MAX_DEPTH || !dropped[depth])
+    trace_add('E', "", 0);
+}
+
+void trace_instant(const char *name) {
+  if(events)
+    trace_add('i', name, depth + 1);
+}
+
+void trace_counter(const char *name, long value) {
+  trace_event *ev;
+
+  if(events && (ev = trace_add('C', name, depth + 1)))
+    ev->value = value;
+}
+
+// Close open spans and write the recorded events to the trace file
+void trace_close(void) {
+  FILE *f;
+  int i;
+
+  if(!events)
+    return;
+
+  while(depth > 0)
+    trace_end();
+
+  if((f = fopen(trace_file, "w")) == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot write trace file %s\n", progname, trace_file);
+  } else {
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(i = 0; i < nevents; i++) {
+      trace_event *ev = events + i;
+
+      fprintf(f, "{\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%.0f", ev->ph, ev->ts);
+      if(ev->ph != 'E')
+        fprintf(f, ",\"name\":\"%s\"", ev->name);
+      if(ev->ph == 'i')
+        fprintf(f, ",\"s\":\"t\"");
+      if(ev->ph == 'C')
+        fprintf(f, ",\"args\":{\"value\":%ld}", ev->value);
+      fprintf(f, "}%s\n", i < nevents-1? ",": "");
+    }
+    fprintf(f, "]}\n");
+    fclose(f);
+
+    if(ndropped)
+      avrdude_message(MSG_INFO, "%s: trace buffer full, %d event%s dropped\n",
+        progname, ndropped, ndropped == 1? "": "s");
+  }
+
+  free(events);
+  free(trace_file);
+  events = NULL;
+  trace_file = NULL;
+}
@@ -347,6 +347,62 @@ static void ioerror(const char *iotype, UPDATE *upd) {
   avrdude_message(MSG_INFO, "\n");
 }
 
+/*
+ * Replace each -U all:w:file.elf (or all:v) with one write (or verify)
+ * per memory of the part for which the ELF file holds data
+ */
+int update_expand_all(struct avrpart *p, LISTID updates) {
+  LNODEID ln, lm, next;
+
+  for(ln = lfirst(updates); ln; ln = next) {
+    UPDATE *upd = ldata(ln);
+    int format, n = 0;
+
+    next = lnext(ln);
+    if(!upd->memtype || strcmp(upd->memtype, "all"))
+      continue;
+
+    if(upd->op == DEVICE_READ) {
+      avrdude_message(MSG_INFO, "%s: -U all:r is not supported, read memories one by one\n",
+        progname);
+      return -1;
+    }
+    format = upd->format;
+    if(format == FMT_AUTO && update_is_readable(upd->filename))
+      format = fileio_fmt_autodetect(upd->filename);
+    if(format != FMT_ELF) {
+      avrdude_message(MSG_INFO, "%s: -U all:%c needs an ELF input file, not %s\n",
+        progname, upd->op == DEVICE_WRITE? 'w': 'v', update_inname(upd->filename));
+      return -1;
+    }
+
+    for(lm = lfirst(p->mem); lm; lm = lnext(lm)) {
+      AVRMEM *m = ldata(lm);
+      int rc;
+
+      // Xmega flash sub-regions are covered by flash
+      if(avr_mem_is_flash_type(m) && strcmp(m->desc, "flash"))
+        continue;
+      if((rc = fileio_elf_has_mem(upd->filename, p, (char *) m->desc)) < 0)
+        return -1;
+      if(rc) {
+        lins_ln(updates, ln, new_update(upd->op, (char *) m->desc, FMT_ELF, upd->filename));
+        avrdude_message(MSG_NOTICE, "%s: -U all:%c:%s includes %s\n", progname,
+          upd->op == DEVICE_WRITE? 'w': 'v', upd->filename, m->desc);
+        n++;
+      }
+    }
+    if(n == 0)
+      avrdude_message(MSG_INFO, "%s: warning: ELF file %s has no data for any memory of %s\n",
+        progname, upd->filename, p->desc);
+
+    lrmv_ln(updates, ln);
+    free_update(upd);
+  }
+
+  return 0;
+}
+
 // Basic checks to reveal serious failure before programming
 int update_dryrun(struct avrpart *p, UPDATE *upd) {
   static char **wrote;
@@ -433,8 +489,184 @@ int update_dryrun(struct avrpart *p, UPDATE *upd) {
 }
 
 
-int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags flags)
-{
+// Read the input files of a write into its memory; later files win where they overlap
+static int update_read_input(struct avrpart *p, AVRMEM *mem, UPDATE *upd, UPDATE **more, int nmore) {
+  unsigned char *buf, *tags;
+  int i, k, rc, size;
+
+  rc = fileio(FIO_READ, upd->filename, upd->format, p, upd->memtype, -1);
+  if (rc < 0) {
+    avrdude_message(MSG_INFO, "%s: read from file %s failed\n",
+      progname, update_inname(upd->filename));
+    return -1;
+  }
+  if (nmore == 0)
+    return rc;
+
+  size = rc;
+  buf = cfg_malloc("update_read_input()", mem->size);
+  tags = cfg_malloc("update_read_input()", mem->size);
+  memcpy(buf, mem->buf, mem->size);
+  memcpy(tags, mem->tags, mem->size);
+
+  for (k = 0; k < nmore; k++) {
+    rc = fileio(FIO_READ, more[k]->filename, more[k]->format, p, more[k]->memtype, -1);
+    if (rc < 0) {
+      avrdude_message(MSG_INFO, "%s: read from file %s failed\n",
+        progname, update_inname(more[k]->filename));
+      free(buf);
+      free(tags);
+      return -1;
+    }
+    if (rc > size)
+      size = rc;
+    for (i = 0; i < mem->size; i++)
+      if (mem->tags[i] & TAG_ALLOCATED) {
+        buf[i] = mem->buf[i];
+        tags[i] |= TAG_ALLOCATED;
+      }
+  }
+
+  memcpy(mem->buf, buf, mem->size);
+  memcpy(mem->tags, tags, mem->size);
+  free(buf);
+  free(tags);
+
+  return size;
+}
+
+const char *update_base;        // Base image for delta programming of flash, see --base
+
+#define UPDATE_BASE_SAMPLES 4   // Number of base image pages checked on the device
+
+/*
+ * Delta programming rewrites single flash pages, so each of them must
+ * be erased first: either by a page erase before the write (Xmega and
+ * UPDI parts) or by a bootloader that erases a page as it writes it
+ * (Optiboot); classic parts otherwise need a chip erase. Clears
+ * UF_AUTO_ERASE in *flags where the bootloader takes care of erasing;
+ * returns 0 if --base can be used and -1 otherwise
+ */
+int update_base_check(const PROGRAMMER *pgm, const AVRPART *p, enum updateflags *flags) {
+  if ((p->prog_modes & (PM_PDI | PM_UPDI)) && pgm->page_erase) {
+    if (!(*flags & UF_AUTO_ERASE)) {
+      avrdude_message(MSG_INFO, "%s: --base needs page erases and cannot be used with -D\n",
+        progname);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(pgm->type, "Arduino") == 0) {
+    *flags &= ~UF_AUTO_ERASE;
+    return 0;
+  }
+
+  avrdude_message(MSG_INFO, "%s: programmer %s cannot erase single flash pages of %s, "
+    "program without --base\n", progname, pgm->type, p->desc);
+  return -1;
+}
+
+// Does the device hold the base image now in mem? Checks CRC or samples a few pages
+static int update_check_base(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem) {
+  int pgsize = mem->page_size > 1? mem->page_size: 1;
+  int i, k, n, npages, rc;
+  unsigned char *buf;
+
+  if (pgm->verify_crc && pgm->verify_crc(pgm, p, mem) > 0)
+    return 1;
+
+  for (npages = 0, i = 0; i < mem->size; i += pgsize)
+    if (memchr(mem->tags + i, TAG_ALLOCATED, pgsize))
+      npages++;
+
+  buf = cfg_malloc("update_check_base()", pgsize);
+  rc = 1;
+  // Spread the samples evenly over the pages set in the base image
+  for (n = 0, k = 0, i = 0; rc == 1 && i < mem->size && n < UPDATE_BASE_SAMPLES; i += pgsize) {
+    if (!memchr(mem->tags + i, TAG_ALLOCATED, pgsize))
+      continue;
+    if (k++ < n*npages/UPDATE_BASE_SAMPLES)
+      continue;
+    n++;
+
+    if (avr_has_paged_access(pgm, mem)) {
+      if (avr_read_page_default(pgm, p, mem, i, buf) < 0)
+        rc = -1;
+    } else {
+      for (int j = 0; rc == 1 && j < pgsize; j++)
+        if (pgm->read_byte(pgm, p, mem, i+j, buf+j) < 0)
+          rc = -1;
+    }
+    for (int j = 0; rc == 1 && j < pgsize; j++)
+      if ((mem->tags[i+j] & TAG_ALLOCATED) && buf[j] != mem->buf[i+j]) {
+        avrdude_message(MSG_NOTICE, "%s: base image differs from device at 0x%04x: 0x%02x != 0x%02x\n",
+          progname, i+j, mem->buf[i+j], buf[j]);
+        rc = 0;
+      }
+  }
+  free(buf);
+
+  return rc;
+}
+
+/*
+ * Delta programming: keep only those pages of the flash image in mem
+ * tagged for writing that differ from the base image; returns the
+ * number of bytes to write or -1 if the device does not hold the base
+ */
+static int update_delta(const PROGRAMMER *pgm, struct avrpart *p, AVRMEM *mem) {
+  int pgsize = mem->page_size > 1? mem->page_size: 1;
+  int i, n, rc, ndiff = 0, npages = 0, size = 0;
+  unsigned char *newbuf;
+
+  newbuf = cfg_malloc("update_delta()", mem->size);
+  memcpy(newbuf, mem->buf, mem->size);
+
+  // Holes are 0xff in both images, which is what an erased page holds
+  rc = fileio(FIO_READ, (char *) update_base, FMT_AUTO, p, (char *) mem->desc, -1);
+  if (rc < 0) {
+    avrdude_message(MSG_INFO, "%s: read from base file %s failed\n", progname, update_base);
+    free(newbuf);
+    return -1;
+  }
+  if ((rc = update_check_base(pgm, p, mem)) <= 0) {
+    if (rc == 0)
+      avrdude_message(MSG_INFO, "%s: device does not hold base image %s, "
+        "program without --base\n", progname, update_base);
+    else
+      avrdude_message(MSG_INFO, "%s: cannot read device to check base image %s\n",
+        progname, update_base);
+    free(newbuf);
+    return -1;
+  }
+
+  for (i = 0; i < mem->size; i += pgsize, npages++) {
+    n = mem->size - i < pgsize? mem->size - i: pgsize;
+    if (memcmp(newbuf + i, mem->buf + i, n)) {
+      memset(mem->tags + i, TAG_ALLOCATED, n);
+      size = i + n;
+      ndiff++;
+    } else
+      memset(mem->tags + i, 0, n);
+  }
+  memcpy(mem->buf, newbuf, mem->size);
+  free(newbuf);
+
+  if (quell_progress < 2)
+    avrdude_message(MSG_INFO, "%s: base image %s confirmed on device, %d of %d page%s differ%s\n",
+      progname, update_base, ndiff, npages, update_plural(npages), ndiff == 1? "s": "");
+
+  return size;
+}
+
+/*
+ * Carry out one update; more[] are further writes of the same memory
+ * whose input files are combined with that of upd into one image
+ */
+static int update_op(PROGRAMMER *pgm, struct avrpart *p, UPDATE *upd, enum updateflags flags,
+  UPDATE **more, int nmore) {
+
   struct avrpart * v;
   AVRMEM * mem;
   int size;
@@ -467,6 +699,7 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
       avrdude_message(MSG_INFO, "%s: reading %s%s memory ...\n",
         progname, mem->desc, alias_mem_desc);
 
+    report_progress_memory(mem->desc);
     report_progress(0, 1, "Reading");
     
     rc = avr_read(pgm, p, upd->memtype, 0);
@@ -496,16 +729,21 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
   case DEVICE_WRITE:
     // Write the selected device memory using data from a file
 
-    rc = fileio(FIO_READ, upd->filename, upd->format, p, upd->memtype, -1);
-    if (rc < 0) {
-      avrdude_message(MSG_INFO, "%s: read from file %s failed\n",
-        progname, update_inname(upd->filename));
+    rc = update_read_input(p, mem, upd, more, nmore);
+    if (rc < 0)
       return LIBAVRDUDE_GENERAL_FAILURE;
-    }
     size = rc;
     if (quell_progress < 2)
-      avrdude_message(MSG_INFO, "%s: reading input file %s for %s%s\n",
-        progname, update_inname(upd->filename), mem->desc, alias_mem_desc);
+      for (int k = -1; k < nmore; k++)
+        avrdude_message(MSG_INFO, "%s: reading input file %s for %s%s\n",
+          progname, update_inname((k < 0? upd: more[k])->filename), mem->desc, alias_mem_desc);
+
+    // Only write pages that differ from the base image known to be on the device
+    if (update_base && !(flags & UF_NOWRITE) && mem == avr_locate_mem(p, "flash")) {
+      if ((rc = update_delta(pgm, p, mem)) < 0)
+        return LIBAVRDUDE_GENERAL_FAILURE;
+      size = rc;
+    }
 
     if(memstats(p, upd->memtype, size, &fs) < 0)
       return LIBAVRDUDE_GENERAL_FAILURE;
@@ -536,6 +774,7 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
         progname, fs.nbytes, update_plural(fs.nbytes), mem->desc, alias_mem_desc);
 
     if (!(flags & UF_NOWRITE)) {
+      report_progress_memory(mem->desc);
       report_progress(0, 1, "Writing");
       rc = avr_write(pgm, p, upd->memtype, size, (flags & UF_AUTO_ERASE) != 0);
       report_progress(1, 1, NULL);
@@ -565,8 +804,11 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
     int userverify = upd->op == DEVICE_VERIFY; // Explicit -U :v by user
 
     if (quell_progress < 2) {
-      avrdude_message(MSG_INFO, "%s: verifying %s%s memory against %s\n",
+      avrdude_message(MSG_INFO, "%s: verifying %s%s memory against %s",
         progname, mem->desc, alias_mem_desc, update_inname(upd->filename));
+      if (nmore > 0)
+        avrdude_message(MSG_INFO, " and %d more file%s", nmore, update_plural(nmore));
+      avrdude_message(MSG_INFO, "\n");
 
       if (userverify)
         avrdude_message(MSG_NOTICE, "%s: load %s%s data from input file %s\n",
@@ -591,6 +833,17 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
       size = fs.lastaddr+1;
     }
 
+    // Let the programmer check the memory on-chip; read back only if that fails
+    if (pgm->verify_crc && pgm->verify_crc(pgm, p, mem) > 0) {
+      if (quell_progress < 2) {
+        int verified = fs.nbytes+fs.ntrailing;
+        avrdude_message(MSG_INFO, "%s: %d byte%s of %s%s verified by on-chip CRC\n",
+          progname, verified, update_plural(verified), mem->desc, alias_mem_desc);
+      }
+      pgm->vfy_led(pgm, OFF);
+      break;
+    }
+
     v = avr_dup_part(p);
 
     if (quell_progress < 2) {
@@ -601,6 +854,7 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
         progname, mem->desc, alias_mem_desc);
     }
 
+    report_progress_memory(mem->desc);
     report_progress (0,1,"Reading");
     rc = avr_read(pgm, p, upd->memtype, v);
     report_progress (1,1,NULL);
@@ -642,3 +896,256 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
 
   return LIBAVRDUDE_SUCCESS;
 }
+
+int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags flags)
+{
+  return update_op(pgm, p, upd, flags, NULL, 0);
+}
+
+
+/*
+ * Scheduling of -U operations within one programming session
+ *
+ * do_ops() does not strictly follow the command line order.  It
+ *   - folds later writes of the same memory into the first one, so the
+ *     memory is written (and verified) once with the combined image;
+ *     later files win where they overlap
+ *   - folds an explicit verify into the write of the same file, so the
+ *     file is parsed once and the memory is read back once
+ *   - runs reads first, then writes of flash, eeprom and other
+ *     memories, then the remaining verifies and finally fuse and lock
+ *     writes, so that programming modes are entered fewer times
+ * No operation is moved across an earlier one it depends on: one that
+ * accesses an overlapping memory where either writes, that uses the
+ * same file where either is a read, or a lock write vs a read or verify.
+ * When the schedule differs from the command line the results are
+ * reported in command line order at the end.
+ */
+
+typedef struct {
+  UPDATE *upd;
+  AVRMEM *mem;
+  int rank;                     // Position class in the schedule
+  int leader;                   // Op that carries out this one
+  int verify;                   // Write leader has an explicit verify folded in
+  int scheduled;
+  int rc;
+  int done;
+} update_step;
+
+static int update_is_fuse(const AVRMEM *m) {
+  return m && strstr(m->desc, "fuse");
+}
+
+static int update_is_lock(const AVRMEM *m) {
+  return m && strncmp(m->desc, "lock", 4) == 0;
+}
+
+static int update_rank(const update_step *s) {
+  switch(s->upd->op) {
+  case DEVICE_READ:
+    return 0;
+  case DEVICE_VERIFY:
+    return 4;
+  default:
+    return update_is_lock(s->mem)? 6: update_is_fuse(s->mem)? 5:
+      s->mem && avr_mem_is_flash_type(s->mem)? 1:
+      s->mem && avr_mem_is_eeprom_type(s->mem)? 2: 3;
+  }
+}
+
+/*
+ * Do the memories overlap? All flash-type memories share the flash and
+ * all fuse-type memories count as one, eg, fuses and fuse5; others
+ * overlap if their ranges in the data space of Xmega and UPDI parts do
+ */
+static int update_mem_overlap(const AVRMEM *a, const AVRMEM *b) {
+  if(!a || !b)
+    return 0;
+
+  if(a == b || (avr_mem_is_flash_type(a) && avr_mem_is_flash_type(b)) ||
+     (update_is_fuse(a) && update_is_fuse(b)))
+    return 1;
+
+  return a->offset && b->offset && a->size > 0 && b->size > 0 &&
+    a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+// Must b (later on the command line) run after a?
+static int update_depends(const update_step *a, const update_step *b) {
+  int aw = a->upd->op == DEVICE_WRITE, bw = b->upd->op == DEVICE_WRITE;
+
+  if((aw || bw) && update_mem_overlap(a->mem, b->mem))
+    return 1;
+
+  if((a->upd->op == DEVICE_READ || b->upd->op == DEVICE_READ) &&
+     a->upd->format != FMT_IMM && b->upd->format != FMT_IMM &&
+     a->upd->filename && b->upd->filename && !strcmp(a->upd->filename, b->upd->filename))
+    return 1;
+
+  // Lock bits can protect memories from being read
+  if((aw && update_is_lock(a->mem) && !bw) || (bw && update_is_lock(b->mem) && !aw))
+    return 1;
+
+  return 0;
+}
+
+// Can op k be carried out together with leader i, ie, earlier than its own position?
+static int update_can_fold(const update_step *steps, int i, int k) {
+  for(int j = i+1; j < k; j++)
+    if(steps[j].leader != i && update_depends(steps+j, steps+k))
+      return 0;
+
+  return 1;
+}
+
+static void update_fold(update_step *steps, int k) {
+  update_step *sk = steps+k;
+
+  if(!sk->mem || sk->upd->op == DEVICE_READ)
+    return;
+
+  for(int i = k-1; i >= 0; i--) {
+    update_step *si = steps+i;
+
+    if(si->leader != i || si->upd->op != DEVICE_WRITE || si->mem != sk->mem || si->verify)
+      continue;
+
+    if(sk->upd->op == DEVICE_VERIFY) {
+      // Only fold a verify into a single write of the very same file
+      int single = 1;
+      for(int j = i+1; j < k; j++)
+        if(steps[j].leader == i)
+          single = 0;
+      if(!single || si->upd->format != sk->upd->format || !si->upd->filename ||
+         !sk->upd->filename || strcmp(si->upd->filename, sk->upd->filename) ||
+         !strcmp(sk->upd->filename, "-"))
+        continue;
+    }
+
+    if(update_can_fold(steps, i, k)) {
+      sk->leader = i;
+      if(sk->upd->op == DEVICE_VERIFY)
+        si->verify = 1;
+    }
+    return;
+  }
+}
+
+// Have all ops that the group of leader g depends on been scheduled?
+static int update_ready(const update_step *steps, int n, int g) {
+  for(int a = g; a < n; a++)
+    if(steps[a].leader == g)
+      for(int b = 0; b < a; b++)
+        if(steps[b].leader != g && !steps[steps[b].leader].scheduled &&
+           update_depends(steps+b, steps+a))
+          return 0;
+
+  return 1;
+}
+
+static void update_opinfo(int level, const update_step *s, const char *result) {
+  const UPDATE *upd = s->upd;
+
+  avrdude_message(level, "%s  -U %s:%c:%s%s%s\n", progbuf, upd->memtype,
+    upd->op == DEVICE_READ? 'r': upd->op == DEVICE_WRITE? 'w': 'v',
+    upd->op == DEVICE_READ? update_outname(upd->filename): update_inname(upd->filename),
+    result? " ": "", result? result: "");
+}
+
+int do_ops(PROGRAMMER *pgm, struct avrpart *p, LISTID updates, enum updateflags flags) {
+  int i, k, n, nsched, nmore, reordered, ret = LIBAVRDUDE_SUCCESS;
+  update_step *steps;
+  UPDATE **more;
+  int *order;
+  LNODEID ln;
+
+  if((n = lsize(updates)) == 0)
+    return ret;
+
+  steps = cfg_malloc("do_ops()", n * sizeof *steps);
+  order = cfg_malloc("do_ops()", n * sizeof *order);
+  more = cfg_malloc("do_ops()", n * sizeof *more);
+
+  for(i = 0, ln = lfirst(updates); ln; ln = lnext(ln), i++) {
+    steps[i].upd = ldata(ln);
+    steps[i].mem = avr_locate_mem(p, steps[i].upd->memtype);
+    steps[i].rank = update_rank(steps+i);
+    steps[i].leader = i;
+  }
+
+  for(k = 1; k < n; k++)
+    update_fold(steps, k);
+
+  // List scheduling: lowest rank first, ties in command line order
+  for(nsched = 0; nsched < n; ) {
+    int best = -1;
+
+    for(i = 0; i < n; i++)
+      if(steps[i].leader == i && !steps[i].scheduled && update_ready(steps, n, i))
+        if(best < 0 || steps[i].rank < steps[best].rank)
+          best = i;
+    if(best < 0)                // Cannot happen, but never loop forever
+      for(i = n-1; i >= 0; i--)
+        if(steps[i].leader == i && !steps[i].scheduled)
+          best = i;
+    if(best < 0)
+      break;
+    steps[best].scheduled = 1;
+    order[nsched++] = best;
+  }
+
+  reordered = nsched != n;
+  for(i = 0; i < nsched; i++)
+    if(order[i] != i)
+      reordered = 1;
+
+  if(reordered && quell_progress < 2) {
+    avrdude_message(MSG_NOTICE, "%s: schedule of -U operations:\n", progname);
+    for(i = 0; i < nsched; i++)
+      for(k = order[i]; k < n; k++)
+        if(steps[k].leader == order[i])
+          update_opinfo(MSG_NOTICE, steps+k, k == order[i]? NULL: "(folded in)");
+  }
+
+  for(i = 0; i < nsched; i++) {
+    update_step *s = steps+order[i];
+    enum updateflags f = flags | (s->verify? UF_VERIFY: 0);
+    char opname[64];
+    int rc;
+
+    nmore = 0;
+    for(k = order[i]+1; k < n; k++)
+      if(steps[k].leader == order[i] && steps[k].upd->op == DEVICE_WRITE)
+        more[nmore++] = steps[k].upd;
+
+    snprintf(opname, sizeof opname, "-U %s:%c", s->upd->memtype,
+      s->upd->op == DEVICE_READ? 'r': s->upd->op == DEVICE_WRITE? 'w': 'v');
+    trace_begin(opname);
+    rc = update_op(pgm, p, s->upd, f, more, nmore);
+    trace_end();
+
+    for(k = order[i]; k < n; k++)
+      if(steps[k].leader == order[i]) {
+        steps[k].rc = rc;
+        steps[k].done = 1;
+      }
+    if(rc && rc != LIBAVRDUDE_SOFTFAIL) {
+      ret = LIBAVRDUDE_GENERAL_FAILURE;
+      break;
+    }
+  }
+
+  if(reordered && quell_progress < 2) {
+    avrdude_message(MSG_INFO, "%s: results of -U operations in command line order:\n", progname);
+    for(k = 0; k < n; k++)
+      update_opinfo(MSG_INFO, steps+k, !steps[k].done? "not done":
+        steps[k].rc == LIBAVRDUDE_SOFTFAIL? "skipped": steps[k].rc? "failed": "OK");
+  }
+
+  free(more);
+  free(order);
+  free(steps);
+
+  return ret;
+}
@@ -104,6 +104,10 @@
 
 #define UPDI_ASI_SYS_CTRLA_UROW_FINAL  1
 
+#define UPDI_ASI_CTRLA_UPDICLKSEL_16MHZ 0x01
+#define UPDI_ASI_CTRLA_UPDICLKSEL_8MHZ  0x02
+#define UPDI_ASI_CTRLA_UPDICLKSEL_4MHZ  0x03
+
 #define UPDI_RESET_REQ_VALUE  0x59
 
 // FLASH CONTROLLER
@@ -65,6 +65,7 @@ static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflag
     avrdude_message(MSG_DEBUG, "%s: Serial port open failed!\n", progname);
     return -1;
   }
+  updi_set_baudrate(pgm, baudrate);
 
   /*
    * drain any extraneous input
@@ -153,9 +154,14 @@ static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
 
   serial_drain(&pgm->fd, 0);
 
+  /*
+   * The double break also resets the UPDI clock to its default, so
+   * fall back to the initial baud rate
+   */
   if (serial_setparams(&pgm->fd, pgm->baudrate? pgm->baudrate: 115200, SERIAL_8E2) < 0) {
     return -1;
   }
+  updi_set_baudrate(pgm, pgm->baudrate? pgm->baudrate: 115200);
 
   updi_set_rtsdtr_mode(pgm);
 
@@ -298,6 +304,20 @@ int updi_link_init(const PROGRAMMER *pgm) {
   return 0;
 }
 
+int updi_link_set_baudrate(const PROGRAMMER *pgm, long baudrate) {
+  avrdude_message(MSG_DEBUG, "%s: Setting baud rate to %ld\n", progname, baudrate);
+
+  if (serial_setparams(&pgm->fd, baudrate, SERIAL_8E2) < 0) {
+    return -1;
+  }
+
+  updi_set_rtsdtr_mode(pgm);
+  serial_drain(&pgm->fd, 0);
+  updi_set_baudrate(pgm, baudrate);
+
+  return 0;
+}
+
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value)  {
 /*
     def ldcs(self, address):
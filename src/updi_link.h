@@ -36,6 +36,7 @@ extern "C" {
 int updi_link_open(PROGRAMMER * pgm);
 void updi_link_close(PROGRAMMER * pgm);
 int updi_link_init(const PROGRAMMER *pgm);
+int updi_link_set_baudrate(const PROGRAMMER *pgm, long baudrate);
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value);
 int updi_link_stcs(const PROGRAMMER *pgm, uint8_t address, uint8_t value);
 int updi_link_ld_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
@@ -47,6 +47,29 @@ typedef enum
 
 #define USE_DEFAULT_COMMAND 0xFF
 
+/* Backoff between NVMCTRL.STATUS polls while the controller is busy */
+#define UPDI_NVM_POLL_MIN_US 100
+#define UPDI_NVM_POLL_MAX_US 2000
+
+static unsigned long nvm_elapsed_us(const struct timeval *from, const struct timeval *to) {
+  return (to->tv_sec - from->tv_sec) * 1000000UL + to->tv_usec - from->tv_usec;
+}
+
+/*
+ * Record how long the pending command kept the controller busy.  The
+ * sample is an upper bound (the first poll that saw it ready), so
+ * smooth it, letting the model drift down towards the real duration.
+ */
+static void nvm_update_timing(updi_nvm_timing *timing, unsigned long busy_us) {
+  unsigned long *model = &timing->busy_us[timing->command];
+
+  *model = *model && busy_us? (3 * *model + busy_us) / 4: busy_us;
+  timing->pending = 0;
+
+  avrdude_message(MSG_DEBUG, "%s: NVM command 0x%02X busy for %lu us, expect %lu us\n",
+                  progname, timing->command, busy_us, *model);
+}
+
 static int nvm_chip_erase_V0(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def chip_erase(self):
@@ -1199,27 +1222,60 @@ int updi_nvm_wait_ready(const PROGRAMMER *pgm, const AVRPART *p) {
         self.logger.error("Wait NVM ready timed out")
         return False
 */
-  unsigned long start_time;
-  unsigned long current_time;
-  struct timeval tv;
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+  unsigned long elapsed, expected, delay = UPDI_NVM_POLL_MIN_US;
+  struct timeval start, tv;
+  int waited = 0;
   uint8_t status;
-  gettimeofday (&tv, NULL);
-  start_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+
+  gettimeofday(&start, NULL);
+  timing->waits++;
+
+  /*
+   * If a command is in progress and we know roughly how long it takes,
+   * sleep through most of that time instead of keeping the link busy
+   * with status reads.
+   */
+  if (timing->pending && (expected = timing->busy_us[timing->command]) > 0) {
+    elapsed = nvm_elapsed_us(&timing->command_time, &start);
+    expected -= expected/8;
+    if (elapsed < expected) {
+      usleep(expected - elapsed);
+      timing->slept_us += expected - elapsed;
+      waited = 1;
+    }
+  }
+
   do {
+    timing->polls++;
     if (updi_read_byte(pgm, p->nvm_base + UPDI_NVMCTRL_STATUS, &status) >= 0) {
       if (status & (1 << UPDI_NVM_STATUS_WRITE_ERROR)) {
         avrdude_message(MSG_INFO, "%s: NVM error\n", progname);
+        timing->pending = 0;
         return -1;
       }
       if (!(status & ((1 << UPDI_NVM_STATUS_EEPROM_BUSY) | 
                       (1 << UPDI_NVM_STATUS_FLASH_BUSY)))) {
+        if (timing->pending) {
+          /* Ready on the first poll, without waiting: the command is quick */
+          gettimeofday(&tv, NULL);
+          nvm_update_timing(timing, waited? nvm_elapsed_us(&timing->command_time, &tv): 0);
+        }
         return 0;
       }
     }
-    gettimeofday (&tv, NULL);
-    current_time = (tv.tv_sec * 1000000) + tv.tv_usec;
-  } while ((current_time - start_time) < 10000000);
 
+    /* Still busy: back off before the next poll */
+    usleep(delay);
+    timing->slept_us += delay;
+    waited = 1;
+    if (delay < UPDI_NVM_POLL_MAX_US)
+      delay *= 2;
+
+    gettimeofday(&tv, NULL);
+  } while (nvm_elapsed_us(&start, &tv) < 10000000);
+
+  timing->pending = 0;
   avrdude_message(MSG_INFO, "%s: Wait NVM ready timed out\n", progname);
   return -1;
 }
@@ -1235,7 +1291,13 @@ int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
         self.logger.debug("NVMCMD %d executing", command)
         return self.readwrite.write_byte(self.device.nvmctrl_address + constants.UPDI_NVMCTRL_CTRLA, command)
 */
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+
   avrdude_message(MSG_DEBUG, "%s: NVMCMD %d executing\n", progname, command);
 
+  timing->pending = 1;
+  timing->command = command;
+  gettimeofday(&timing->command_time, NULL);
+
   return updi_write_byte(pgm, p->nvm_base + UPDI_NVMCTRL_CTRLA, command);
 }
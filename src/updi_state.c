@@ -33,6 +33,10 @@ updi_sib_info* updi_get_sib_info(const PROGRAMMER *pgm) {
   return &((updi_state *)(pgm->cookie))->sib_info;
 }
 
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm) {
+  return &((updi_state *)(pgm->cookie))->nvm_timing;
+}
+
 updi_datalink_mode updi_get_datalink_mode(const PROGRAMMER *pgm) {
   return ((updi_state *)(pgm->cookie))->datalink_mode;
 }
@@ -56,3 +60,27 @@ updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm) {
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode) {
   ((updi_state *)(pgm->cookie))->rts_mode = mode;
 }
+
+int updi_get_autobaud(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->autobaud;
+}
+
+void updi_set_autobaud(const PROGRAMMER *pgm, int autobaud) {
+  ((updi_state *)(pgm->cookie))->autobaud = autobaud;
+}
+
+long updi_get_baudrate(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->baudrate;
+}
+
+void updi_set_baudrate(const PROGRAMMER *pgm, long baudrate) {
+  ((updi_state *)(pgm->cookie))->baudrate = baudrate;
+}
+
+int updi_get_crc_verify(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->crc_verify;
+}
+
+void updi_set_crc_verify(const PROGRAMMER *pgm, int crc_verify) {
+  ((updi_state *)(pgm->cookie))->crc_verify = crc_verify;
+}
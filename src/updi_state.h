@@ -27,6 +27,8 @@
 #ifndef updi_state_h
 #define updi_state_h
 
+#include <sys/time.h>
+
 #include "libavrdude.h"
 
 typedef enum
@@ -68,12 +70,32 @@ typedef enum
   RTS_MODE_HIGH
 } updi_rts_mode;
 
+/*
+ * Timing model for NVM controller operations: the time from issuing
+ * each NVM command until the controller was last seen ready again,
+ * smoothed over the session, plus counters for the verbose summary
+ */
+typedef struct
+{
+  int pending;                    // A command was issued and not yet seen complete
+  uint8_t command;                // Last NVM command issued
+  struct timeval command_time;    // When it was issued
+  unsigned long busy_us[256];     // Expected busy time per command, 0 if unknown
+  unsigned long waits;            // Calls to updi_nvm_wait_ready()
+  unsigned long polls;            // NVMCTRL.STATUS reads
+  unsigned long slept_us;         // Time spent sleeping instead of polling
+} updi_nvm_timing;
+
 typedef struct
 {
   updi_sib_info sib_info;
+  updi_nvm_timing nvm_timing;
   updi_datalink_mode datalink_mode;
   updi_nvm_mode nvm_mode;
   updi_rts_mode rts_mode;
+  int autobaud;
+  long baudrate;
+  int crc_verify;
 } updi_state;
 
 #ifdef __cplusplus
@@ -81,12 +103,19 @@ extern "C" {
 #endif
 
 updi_sib_info* updi_get_sib_info(const PROGRAMMER *pgm);
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm);
 updi_datalink_mode updi_get_datalink_mode(const PROGRAMMER *pgm);
 void updi_set_datalink_mode(const PROGRAMMER *pgm, updi_datalink_mode mode);
 updi_nvm_mode updi_get_nvm_mode(const PROGRAMMER *pgm);
 void updi_set_nvm_mode(const PROGRAMMER *pgm, updi_nvm_mode mode);
 updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm);
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode);
+int updi_get_autobaud(const PROGRAMMER *pgm);
+void updi_set_autobaud(const PROGRAMMER *pgm, int autobaud);
+long updi_get_baudrate(const PROGRAMMER *pgm);
+void updi_set_baudrate(const PROGRAMMER *pgm, long baudrate);
+int updi_get_crc_verify(const PROGRAMMER *pgm);
+void updi_set_crc_verify(const PROGRAMMER *pgm, int crc_verify);
 
 #ifdef __cplusplus
 }
@@ -143,6 +143,10 @@ struct pdata
   int use_tpi;
   int section_e;
   int sck_3mhz;
+
+  long dev_addr;                // Device-side address of next paged access, -1 = unknown
+  const AVRMEM *dev_addr_mem;   // Memory that dev_addr refers to
+  double xfer_rate;             // Measured paged transfer rate in bytes/s, 0 = unknown
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -268,6 +272,7 @@ static void usbasp_setup(PROGRAMMER * pgm)
     exit(1);
   }
   memset(pgm->cookie, 0, sizeof(struct pdata));
+  PDATA(pgm)->dev_addr = -1;
 }
 
 static void usbasp_teardown(PROGRAMMER * pgm)
@@ -667,6 +672,11 @@ static int usbasp_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
 
   avrdude_message(MSG_DEBUG, "%s: usbasp_initialize()\n", progname);
 
+  /* (re)connecting resets the programmer's address and timing state */
+  pdata->dev_addr = -1;
+  pdata->dev_addr_mem = NULL;
+  pdata->xfer_rate = 0;
+
   /* get capabilities */
   memset(temp, 0, sizeof(temp));
   if(usbasp_transmit(pgm, 1, USBASP_FUNC_GETCAPABILITIES, temp, res, sizeof(res)) == 4)
@@ -780,6 +790,76 @@ static int usbasp_spi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   return 0;
 }
 
+/*
+ * Tell the programmer where the next paged access starts unless it already
+ * knows: firmware that supports the "new mode" auto-increments the address
+ * it received with USBASP_FUNC_SETLONGADDRESS, so it only needs to be sent
+ * at discontinuities, on a memory change or when crossing a 64 KiB boundary.
+ * Older firmware ignores this command and uses the address that is passed
+ * with every read/write command for compatibility.
+ */
+static void usbasp_set_long_address(const PROGRAMMER *pgm, const AVRMEM *m, unsigned int address) {
+  IMPORT_PDATA(pgm);
+  unsigned char cmd[4];
+  unsigned char temp[4];
+
+  if(pdata->dev_addr == (long) address && pdata->dev_addr_mem == m && (address & 0xffff) != 0)
+    return;
+
+  memset(temp, 0, sizeof(temp));
+  cmd[0] = address & 0xFF;
+  cmd[1] = address >> 8;
+  cmd[2] = address >> 16;
+  cmd[3] = address >> 24;
+  if(usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp)) < 0) {
+    pdata->dev_addr = -1;
+    return;
+  }
+  pdata->dev_addr = address;
+  pdata->dev_addr_mem = m;
+}
+
+/*
+ * Block size for paged access: small enough that a single control transfer
+ * finishes in about USBASP_BLOCKTIME_US. The transfer rate measured on
+ * earlier blocks takes precedence over the rate estimated from the SCK
+ * frequency; with neither known (auto SCK), use the maximum size.
+ */
+static int usbasp_blocksize(const PROGRAMMER *pgm, int maxsize) {
+  IMPORT_PDATA(pgm);
+  double rate, size;
+
+  if(pdata->xfer_rate > 0)
+    rate = pdata->xfer_rate;
+  else if(pdata->sckfreq_hz > 0)
+    rate = (double) pdata->sckfreq_hz/USBASP_SCK_PER_BYTE;
+  else
+    return maxsize;
+
+  size = rate*USBASP_BLOCKTIME_US/1e6;
+  if(size > maxsize)
+    return maxsize;
+  if(size < USBASP_MINBLOCKSIZE)
+    return USBASP_MINBLOCKSIZE;
+  return (int) size;
+}
+
+// Update the measured transfer rate after a block of nbytes took from tv0 until now
+static void usbasp_update_rate(const PROGRAMMER *pgm, int nbytes, const struct timeval *tv0) {
+  IMPORT_PDATA(pgm);
+  struct timeval tv;
+  double elapsed, rate;
+
+  gettimeofday(&tv, NULL);
+  elapsed = (tv.tv_sec - tv0->tv_sec) + (tv.tv_usec - tv0->tv_usec)/1e6;
+  if(elapsed <= 0 || nbytes <= 0)
+    return;
+
+  rate = nbytes/elapsed;
+  // Exponential smoothing so that a single slow transfer does not dominate
+  pdata->xfer_rate = pdata->xfer_rate > 0? (3*pdata->xfer_rate + rate)/4: rate;
+}
+
 static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
   unsigned int page_size, unsigned int address, unsigned int n_bytes) {
 
@@ -789,6 +869,7 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
   int blocksize;
   unsigned char *buffer = m->buf + address;
   int function;
+  struct timeval tv;
 
   avrdude_message(MSG_DEBUG, "%s: usbasp_program_paged_load(\"%s\", 0x%x, %d)\n",
                     progname, m->desc, address, n_bytes);
@@ -801,27 +882,16 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     return -2;
   }
 
-  /* set blocksize depending on sck frequency */  
-  if ((PDATA(pgm)->sckfreq_hz > 0) && (PDATA(pgm)->sckfreq_hz < 10000)) {
-     blocksize = USBASP_READBLOCKSIZE / 10;
-  } else {
-     blocksize = USBASP_READBLOCKSIZE;
-  }
-
   while (wbytes) {
+    /* set blocksize depending on transfer rate */
+    blocksize = usbasp_blocksize(pgm, USBASP_READBLOCKSIZE);
     if (wbytes <= blocksize) {
       blocksize = wbytes;
     }
     wbytes -= blocksize;
 
-    /* set address (new mode) - if firmware on usbasp support newmode, then they use address from this command */
-    unsigned char temp[4];
-    memset(temp, 0, sizeof(temp));
-    cmd[0] = address & 0xFF;
-    cmd[1] = address >> 8;
-    cmd[2] = address >> 16;
-    cmd[3] = address >> 24;
-    usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp));
+    /* set address (new mode) - only when the programmer's copy is out of step */
+    usbasp_set_long_address(pgm, m, address);
 
     /* send command with address (compatibility mode) - if firmware on
 	  usbasp doesn't support newmode, then they use address from this */
@@ -831,16 +901,20 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     cmd[2] = 0;
     cmd[3] = 0;
 
+    gettimeofday(&tv, NULL);
     n = usbasp_transmit(pgm, 1, function, cmd, buffer, blocksize);
 
     if (n != blocksize) {
+      PDATA(pgm)->dev_addr = -1;
       avrdude_message(MSG_INFO, "%s: error: wrong reading bytes %x\n",
 	      progname, n);
       return -3;
     }
+    usbasp_update_rate(pgm, blocksize, &tv);
 
     buffer += blocksize;
     address += blocksize;
+    PDATA(pgm)->dev_addr = address;
   }
 
   return n_bytes;
@@ -856,6 +930,7 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
   unsigned char *buffer = m->buf + address;
   unsigned char blockflags = USBASP_BLOCKFLAG_FIRST;
   int function;
+  struct timeval tv;
 
   avrdude_message(MSG_DEBUG, "%s: usbasp_program_paged_write(\"%s\", 0x%x, %d)\n",
                     progname, m->desc, address, n_bytes);
@@ -868,30 +943,16 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     return -2;
   }
 
-  /* set blocksize depending on sck frequency */  
-  if ((PDATA(pgm)->sckfreq_hz > 0) && (PDATA(pgm)->sckfreq_hz < 10000)) {
-     blocksize = USBASP_WRITEBLOCKSIZE / 10;
-  } else {
-     blocksize = USBASP_WRITEBLOCKSIZE;
-  }
-
   while (wbytes) {
-
+    /* set blocksize depending on transfer rate */
+    blocksize = usbasp_blocksize(pgm, USBASP_WRITEBLOCKSIZE);
     if (wbytes <= blocksize) {
       blocksize = wbytes;
     }
     wbytes -= blocksize;
 
-
-    /* set address (new mode) - if firmware on usbasp support newmode, then
-      they use address from this command */
-    unsigned char temp[4];
-    memset(temp, 0, sizeof(temp));
-    cmd[0] = address & 0xFF;
-    cmd[1] = address >> 8;
-    cmd[2] = address >> 16;
-    cmd[3] = address >> 24;
-    usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp));
+    /* set address (new mode) - only when the programmer's copy is out of step */
+    usbasp_set_long_address(pgm, m, address);
 
     /* normal command - firmware what support newmode - use address from previous command,
       firmware what doesn't support newmode - ignore previous command and use address from this command */
@@ -902,17 +963,20 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     cmd[3] = (blockflags & 0x0F) + ((page_size & 0xF00) >> 4); //TP: Mega128 fix
     blockflags = 0;
 
+    gettimeofday(&tv, NULL);
     n = usbasp_transmit(pgm, 0, function, cmd, buffer, blocksize);
 
     if (n != blocksize) {
+      PDATA(pgm)->dev_addr = -1;
       avrdude_message(MSG_INFO, "%s: error: wrong count at writing %x\n",
 	      progname, n);
       return -3;        
     }
-
+    usbasp_update_rate(pgm, blocksize, &tv);
 
     buffer += blocksize;
     address += blocksize;
+    PDATA(pgm)->dev_addr = address;
   }
 
   return n_bytes;
@@ -950,8 +1014,9 @@ static int usbasp_spi_set_sck_period(const PROGRAMMER *pgm, double sckperiod) {
   memset(cmd, 0, sizeof(cmd));
   memset(res, 0, sizeof(res));
 
-  /* reset global sck frequency to auto */
+  /* reset global sck frequency to auto, forget transfer rate measured so far */
   PDATA(pgm)->sckfreq_hz = 0;
+  PDATA(pgm)->xfer_rate = 0;
 
   if (sckperiod == 0) {
     /* auto sck set */
@@ -1316,7 +1381,7 @@ void usbasp_initpgm(PROGRAMMER *pgm) {
   pgm->teardown       = usbasp_teardown;
   pgm->set_sck_period = usbasp_set_sck_period;
   pgm->parseextparams = usbasp_parseextparms;
-
+  pgm->max_paged_xfer = 1024;
 }
 
 
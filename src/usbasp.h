@@ -51,6 +51,12 @@
 /* Block mode data size */
 #define USBASP_READBLOCKSIZE   200
 #define USBASP_WRITEBLOCKSIZE  200
+#define USBASP_MINBLOCKSIZE      8    /* one low-speed USB data packet */
+
+/* Target duration of one block transfer, well below the 5 s USB timeout */
+#define USBASP_BLOCKTIME_US  500000
+/* SCK cycles per byte of paged access (one 4-byte ISP instruction) */
+#define USBASP_SCK_PER_BYTE     32
 
 /* ISP SCK speed identifiers */
 #define USBASP_ISP_SCK_AUTO   0
@@ -61,6 +61,24 @@ typedef	unsigned int	uint_t;
 typedef	unsigned long	ulong_t;
 #endif
 
+#define TUNE_SAMPLES	4	// full chunks timed per candidate chunk size
+
+/*
+ * State of the chunk size tuning for one direction (read or write):
+ * each candidate size is timed over TUNE_SAMPLES chunks, and the size
+ * is doubled for as long as that raises the throughput
+ */
+struct chunk_tune
+{
+  int size;			// chunk size in use
+  int best;			// best size measured so far, 0 if none yet
+  double best_rate;		// its throughput in bytes per microsecond
+  int n;			// chunks timed at the current size
+  long bytes;
+  double usecs;
+  int done;
+};
+
 /*
  * Private data for this programmer.
  */
@@ -70,8 +88,14 @@ struct pdata
   int sck_period;
   int chunk_size;
   int retries;
+  int chunk_fixed;		// -x chunksize=<n>, 0 if not given
+  int chunk_auto;		// -x chunksize=auto
+  struct chunk_tune tune[2];	// indexed by TUNE_READ/TUNE_WRITE
 };
 
+#define TUNE_READ	0
+#define TUNE_WRITE	1
+
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
 
 // ----------------------------------------------------------------------
@@ -403,6 +427,103 @@ static void usbtiny_set_chunk_size (const PROGRAMMER *pgm, int period) {
     PDATA(pgm)->chunk_size >>= 1;
     period >>= 1;
   }
+
+  if (PDATA(pgm)->chunk_fixed)
+    PDATA(pgm)->chunk_size = PDATA(pgm)->chunk_fixed;
+
+  // the static size is where tuning starts; it is redone for a new SCK
+  for (int dir = TUNE_READ; dir <= TUNE_WRITE; dir++) {
+    memset(&PDATA(pgm)->tune[dir], 0, sizeof(struct chunk_tune));
+    PDATA(pgm)->tune[dir].size = PDATA(pgm)->chunk_size;
+    PDATA(pgm)->tune[dir].done = !PDATA(pgm)->chunk_auto;
+  }
+}
+
+// Chunk size to use next for reading or writing
+static int usbtiny_chunk_size (const PROGRAMMER *pgm, int dir) {
+  return PDATA(pgm)->chunk_auto? PDATA(pgm)->tune[dir].size: PDATA(pgm)->chunk_size;
+}
+
+/*
+ * Account for a chunk transfer of the given size that took usecs and
+ * pick the size of the next one.  Bigger chunks mean fewer USB control
+ * transfers, but the firmware clocks a whole chunk out before it answers,
+ * so a chunk must stay well within USB_TIMEOUT; a chunk that needed
+ * retries or came close to it ends tuning at the previous size.
+ */
+static void usbtiny_tune_chunk (const PROGRAMMER *pgm, int dir, int bytes,
+                                double usecs, int retried) {
+  struct chunk_tune *t = &PDATA(pgm)->tune[dir];
+  double rate;
+
+  if (t->done || bytes < t->size)  // only full chunks tell the throughput
+    return;
+
+  if (retried || usecs > USB_TIMEOUT * 1000.0 / 2) {
+    t->size = t->best? t->best: t->size > 8? t->size >> 1: 8;
+    t->done = 1;
+  } else {
+    t->bytes += bytes;
+    t->usecs += usecs;
+    if (++t->n < TUNE_SAMPLES)
+      return;
+
+    rate = t->usecs > 0? t->bytes / t->usecs: 0;
+    if (t->best == 0 || rate > t->best_rate * 1.05) {
+      t->best = t->size;
+      t->best_rate = rate;
+      // try the next size unless its chunks could come close to the timeout
+      if (t->size < CHUNK_SIZE && 2 * t->usecs / t->n <= USB_TIMEOUT * 1000.0 / 4) {
+        t->size <<= 1;
+        t->n = 0;
+        t->bytes = 0;
+        t->usecs = 0;
+        return;
+      }
+    }
+    t->size = t->best;
+    t->done = 1;
+  }
+
+  avrdude_message(MSG_NOTICE, "%s: using %s chunk size %d (%.0f bytes/s)\n", progname,
+                  dir == TUNE_READ? "read": "write", t->size, t->best_rate * 1e6);
+}
+
+static double usbtiny_usecs (const struct timeval *start) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec - start->tv_sec) * 1e6 + (tv.tv_usec - start->tv_usec);
+}
+
+static int usbtiny_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
+  LNODEID ln;
+  const char *extended_param;
+  int rv = 0;
+
+  for (ln = lfirst(extparms); ln; ln = lnext(ln)) {
+    extended_param = ldata(ln);
+
+    if (strcmp(extended_param, "chunksize=auto") == 0) {
+      PDATA(pgm)->chunk_auto = 1;
+      continue;
+    }
+
+    if (strncmp(extended_param, "chunksize=", strlen("chunksize=")) == 0) {
+      int size = atoi(extended_param + strlen("chunksize="));
+
+      if (size >= 8 && size <= CHUNK_SIZE && (size & (size-1)) == 0) {
+        PDATA(pgm)->chunk_fixed = size;
+        continue;
+      }
+    }
+
+    avrdude_message(MSG_INFO, "%s: usbtiny_parseextparms(): invalid extended parameter '%s'\n",
+                    progname, extended_param);
+    rv = -1;
+  }
+
+  return rv;
 }
 
 /* Given a SCK bit-clock speed (in useconds) we verify its an OK speed and tell the
@@ -581,6 +702,57 @@ int usbtiny_cmd_tpi(const PROGRAMMER *pgm, const unsigned char *cmd,
   return 0;
 }
 
+/* Executes a stream of TPI instructions (see tpi_insn_len()). Bytes
+   to transmit are paired into one USB transfer each regardless of
+   instruction boundaries; an instruction producing a response is
+   sent together with its receive window. Delays are done on the
+   host, leaving the TPI link idle. */
+static int usbtiny_cmd_tpi_block(const PROGRAMMER *pgm, const unsigned char *cmd,
+			int cmd_len, unsigned char *res, int res_len)
+{
+  int i, j, n, nres, r, rx, pending = -1;
+
+  for (i = rx = 0; i < cmd_len; i += n) {
+    n = tpi_insn_len(cmd[i], &nres);
+    if (i + n > cmd_len || rx + nres > res_len) {
+      fprintf(stderr, "%s: malformed block at %d (cmd_len=%d/res_len=%d)\n",
+	      __func__, i, cmd_len, res_len);
+      return -1;
+    }
+
+    if (cmd[i] == TPI_BLOCK_DELAY || nres > 0) {
+      /* Flush a pending byte first */
+      if (pending >= 0 && usbtiny_tpi_tx(pgm, pending) < 0)
+	return -1;
+      pending = -1;
+
+      if (cmd[i] == TPI_BLOCK_DELAY) {
+	usleep(cmd[i+1] * TPI_BLOCK_DELAY_UNIT);
+      } else {
+	if ((r = usbtiny_tpi_txrx(pgm, cmd[i])) < 0)
+	  return -1;
+	res[rx++] = r;
+      }
+      continue;
+    }
+
+    for (j = 0; j < n; j++) {
+      if (pending < 0) {
+	pending = cmd[i+j];
+      } else {
+	if (usbtiny_tpi_txtx(pgm, pending, cmd[i+j]) < 0)
+	  return -1;
+	pending = -1;
+      }
+    }
+  }
+
+  if (pending >= 0 && usbtiny_tpi_tx(pgm, pending) < 0)
+    return -1;
+
+  return 0;
+}
+
 static int usbtiny_spi(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned char *res, int count) {
   int i;
 
@@ -686,13 +858,17 @@ static int usbtiny_paged_load (const PROGRAMMER *pgm, const AVRPART *p, const AV
   }
 
   for (; addr < maxaddr; addr += chunk) {
-    chunk = PDATA(pgm)->chunk_size;         // start with the maximum chunk size possible
+    struct timeval start;
+    int retries = PDATA(pgm)->retries;
+
+    chunk = usbtiny_chunk_size(pgm, TUNE_READ); // start with the maximum chunk size possible
     if (addr + chunk > maxaddr) {
         chunk = maxaddr - addr;
     }
 
     // Send the chunk of data to the USBtiny with the function we want
     // to perform
+    gettimeofday(&start, NULL);
     if (usb_in(pgm,
 	       function,          // EEPROM or flash
 	       0,                 // delay between SPI commands
@@ -704,6 +880,8 @@ static int usbtiny_paged_load (const PROGRAMMER *pgm, const AVRPART *p, const AV
                               // usb_in() multiplies this per byte.
       return -1;
     }
+    usbtiny_tune_chunk(pgm, TUNE_READ, chunk, usbtiny_usecs(&start),
+                       PDATA(pgm)->retries > retries);
   }
 
   check_retries(pgm, "read");
@@ -743,8 +921,10 @@ static int usbtiny_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AV
   }
 
   for (; addr < maxaddr; addr += chunk) {
+    struct timeval start;
+
     // start with the max chunk size
-    chunk = PDATA(pgm)->chunk_size;
+    chunk = usbtiny_chunk_size(pgm, TUNE_WRITE);
     if (addr + chunk > maxaddr) {
         chunk = maxaddr - addr;
     }
@@ -753,6 +933,7 @@ static int usbtiny_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AV
     if (m->paged && chunk > page_size)
       chunk = page_size;
 
+    gettimeofday(&start, NULL);
     if (usb_out(pgm,
 		function,       // Flash or EEPROM
 		delay,          // How much to wait between each byte
@@ -765,6 +946,7 @@ static int usbtiny_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AV
 		) < 0) {
       return -1;
     }
+    usbtiny_tune_chunk(pgm, TUNE_WRITE, chunk, usbtiny_usecs(&start), 0);
 
     next = addr + chunk;       // Calculate what address we're at now
     if (m->paged
@@ -796,6 +978,7 @@ void usbtiny_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase	= usbtiny_chip_erase;
   pgm->cmd		= usbtiny_cmd;
   pgm->cmd_tpi		= usbtiny_cmd_tpi;
+  pgm->cmd_tpi_block	= usbtiny_cmd_tpi_block;
   pgm->open		= usbtiny_open;
   pgm->close		= usbtiny_close;
   pgm->read_byte        = avr_read_byte_default;
@@ -809,6 +992,7 @@ void usbtiny_initpgm(PROGRAMMER *pgm) {
   pgm->set_sck_period	= usbtiny_set_sck_period;
   pgm->setup            = usbtiny_setup;
   pgm->teardown         = usbtiny_teardown;
+  pgm->parseextparams   = usbtiny_parseextparms;
   pgm->setpin           = usbtiny_setpin;
   pgm->spi              = usbtiny_spi;
 }
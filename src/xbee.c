@@ -96,10 +96,42 @@
 #define XBEE_MAX_INTERMEDIATE_HOPS 40
 #endif
 
+/*
+ * Maximum number of chunks that may be outstanding (sent, but not yet
+ * ACK'd) in windowed transmit mode.
+ */
+#ifndef XBEE_MAX_WINDOW
+#define XBEE_MAX_WINDOW 16
+#endif
+
+/*
+ * Bounds for the RTT-adaptive retransmission timeout in windowed
+ * mode, in milliseconds.  The upper bound is also the initial value
+ * before the first round trip has been measured.
+ */
+#define XBEE_MIN_RTO_MS 50
+#define XBEE_MAX_RTO_MS 1000
+
 /* Protocol */
 #define XBEEBOOT_PACKET_TYPE_ACK 0
 #define XBEEBOOT_PACKET_TYPE_REQUEST 1
 
+/*
+ * Application request types carried in REQUEST packets.
+ *
+ * A WINDOW_QUERY is sent with the otherwise illegal sequence number
+ * zero so that bootloaders which do not know it silently drop it
+ * without disturbing their sequence state.  A bootloader supporting
+ * windowed transfers answers with an ACK for sequence zero, carrying
+ * the number of chunks it is prepared to buffer.
+ */
+#define XBEEBOOT_FIRMWARE_DELIVER 23
+#define XBEEBOOT_FIRMWARE_REPLY 24
+#define XBEEBOOT_WINDOW_QUERY 25
+
+/* Pseudo sequence for xbeedev_poll(): return on any non-zero ACK */
+#define XBEE_ANY_ACK 256
+
 /*
  * Read signature bytes - Direct copy of the Arduino behaviour to
  * satisfy Optiboot.
@@ -211,6 +243,21 @@ struct XBeeBootSession {
 
   struct XBeeSequenceStatistics sequenceStatistics[256 * XBEE_STATS_GROUPS];
   struct XBeeStaticticsSummary groupSummary[XBEE_STATS_GROUPS];
+
+  /*
+   * Windowed transmit mode: number of chunks that may be outstanding
+   * (1 is stop-and-wait), window size offered by the bootloader,
+   * ACKs seen per sequence number, smoothed round trip time and its
+   * variation in microseconds (-1 until measured), the current
+   * retransmission timeout and the number of retransmitted chunks.
+   */
+  int window;
+  int windowOffer;
+  unsigned char acked[256];
+  long srtt;
+  long rttvar;
+  long rto;
+  unsigned long retransmissions;
 };
 
 static void xbeeStatsReset(struct XBeeStaticticsSummary *summary)
@@ -284,6 +331,13 @@ static void XBeeBootSessionInit(struct XBeeBootSession *xbs) {
   xbs->inOutIndex = 0;
   xbs->sourceRouteHops = -1;
   xbs->sourceRouteChanged = 0;
+  xbs->window = 1;
+  xbs->windowOffer = 0;
+  memset(xbs->acked, 0, sizeof(xbs->acked));
+  xbs->srtt = -1;
+  xbs->rttvar = 0;
+  xbs->rto = XBEE_MAX_RTO_MS * 1000L;
+  xbs->retransmissions = 0;
 
   int group;
   for (group = 0; group < 3; group++) {
@@ -302,6 +356,13 @@ static void xbeedev_setresetpin(const union filedescriptor *fdp, int xbeeResetPi
   xbs->xbeeResetPin = xbeeResetPin;
 }
 
+static long xbeedev_elapsed(const struct timeval *from,
+                            const struct timeval *to)
+{
+  return (to->tv_sec - from->tv_sec) * 1000000L +
+    (to->tv_usec - from->tv_usec);
+}
+
 enum xbee_stat_is_retry_enum {XBEE_STATS_NOT_RETRY, XBEE_STATS_IS_RETRY};
 typedef enum xbee_stat_is_retry_enum xbee_stat_is_retry;
 
@@ -856,14 +917,23 @@ static int xbeedev_poll(struct XBeeBootSession *xbs,
                                 XBEE_STATS_TRANSMIT, sequence,
                                 &receiveTime);
 
+          if (sequence == 0 && dataLength >= 3)
+            /* Reply to XBEEBOOT_WINDOW_QUERY */
+            xbs->windowOffer = dataStart[2];
+
           /*
            * We can't update outSequence here, we already do that
-           * somewhere else.
+           * somewhere else.  Do remember the ACK, though, for the
+           * benefit of windowed transmissions.
            */
-          if (waitForAck >= 0 && waitForAck == sequence)
+          xbs->acked[sequence] = 1;
+          if (waitForAck >= 0 &&
+              (waitForAck == sequence ||
+               (waitForAck == XBEE_ANY_ACK && sequence != 0)))
             return 0;
         } else if (protocolType == XBEEBOOT_PACKET_TYPE_REQUEST &&
-                   dataLength >= 4 && dataStart[2] == 24) {
+                   dataLength >= 4 &&
+                   dataStart[2] == XBEEBOOT_FIRMWARE_REPLY) {
           /* REQUEST FRAME_REPLY */
           xbeedev_stats_receive(xbs, "XBeeBoot Receive", XBEE_STATS_RECEIVE,
                                 sequence, &receiveTime);
@@ -1307,6 +1377,276 @@ static int xbeedev_open(const char *port, union pinfo pinfo,
   return 0;
 }
 
+static unsigned char xbeedev_max_chunk(const struct XBeeBootSession *xbs)
+{
+  /*
+   * Chunk the data into chunks of up to XBEEBOOT_MAX_CHUNK bytes.
+   */
+  unsigned char maximum_chunk = XBEEBOOT_MAX_CHUNK;
+
+  /*
+   * Source routing incurs a two byte fixed overhead, plus a two
+   * byte additional cost per intermediate hop.
+   *
+   * We are attempting to avoid fragmentation here, so resize our
+   * maximum size to anticipate the overhead of the current number
+   * of hops.  If our maximum chunk would be less than one, just
+   * give up and hope fragmentation will somehow save us.
+   */
+  const int hops = xbs->sourceRouteHops;
+  if (hops > 0 && (hops * 2 + 2) < XBEEBOOT_MAX_CHUNK)
+    maximum_chunk -= hops * 2 + 2;
+
+  return maximum_chunk;
+}
+
+static void xbeedev_hint_receive(struct XBeeBootSession *xbs)
+{
+  /*
+   * We are about to send some data, and that might lead potentially
+   * to received data before we see the ACK for this transmission.
+   * As this might be the trigger seen before the next "recv"
+   * operation, record that we have delivered this potential
+   * trigger.
+   */
+  unsigned char nextSequence = xbs->inSequence;
+  while ((++nextSequence & 0xff) == 0);
+
+  struct timeval sendTime;
+  gettimeofday(&sendTime, NULL);
+
+  /*
+   * Optimistic records should never be treated as retries,
+   * because they might simply be guessing too optimistically.
+   */
+  xbeedev_stats_send(xbs, "send() hints possible triggered RECEIVE",
+                     nextSequence,
+                     XBEE_STATS_RECEIVE,
+                     nextSequence, 0, &sendTime);
+}
+
+/*
+ * Ask the remote XBeeBoot bootloader whether it can buffer more than
+ * one outstanding chunk.  The query uses sequence number zero, which
+ * is never used for data, so a bootloader that does not understand
+ * it drops it without losing sync; in that case, or if the offer is
+ * less than two, stay with stop-and-wait.
+ */
+static int xbeedev_setwindow(const union filedescriptor *fdp, int window)
+{
+  struct XBeeBootSession *xbs = xbeebootsession(fdp);
+
+  xbs->window = 1;
+  if (window <= 1)
+    return 0;
+
+  if (window > XBEE_MAX_WINDOW)
+    window = XBEE_MAX_WINDOW;
+
+  const unsigned char request = window;
+  xbs->windowOffer = 0;
+  xbs->acked[0] = 0;
+
+  int retries;
+  for (retries = 0; retries < 3; retries++) {
+    const int sendRc = sendPacket(xbs, "Transmit Request Window Query",
+                                  XBEEBOOT_PACKET_TYPE_REQUEST, 0,
+                                  retries > 0 ?
+                                  XBEE_STATS_IS_RETRY : XBEE_STATS_NOT_RETRY,
+                                  XBEEBOOT_WINDOW_QUERY, 1, &request);
+    if (sendRc < 0)
+      return sendRc;
+
+    if (xbeedev_poll(xbs, NULL, NULL, 0, -1) == 0)
+      break;
+  }
+
+  if (!xbs->acked[0] || xbs->windowOffer < 2) {
+    avrdude_message(MSG_NOTICE, "%s: xbeedev_setwindow(): remote XBeeBoot "
+                    "does not support windowed transfers, "
+                    "using stop-and-wait\n", progname);
+    return 0;
+  }
+
+  xbs->window = xbs->windowOffer < window ? xbs->windowOffer : window;
+
+  avrdude_message(MSG_NOTICE, "%s: xbeedev_setwindow(): using a transmit "
+                  "window of %d chunks (requested %d, offered %d)\n",
+                  progname, xbs->window, window, xbs->windowOffer);
+  return 0;
+}
+
+/*
+ * Update the retransmission timeout from a round trip measurement,
+ * as per RFC 6298.  Only chunks that were ACK'd after their first
+ * transmission are sampled (Karn's algorithm).
+ */
+static void xbeedev_update_rto(struct XBeeBootSession *xbs, long rtt)
+{
+  if (xbs->srtt < 0) {
+    xbs->srtt = rtt;
+    xbs->rttvar = rtt / 2;
+  } else {
+    const long delta = rtt > xbs->srtt ? rtt - xbs->srtt : xbs->srtt - rtt;
+    xbs->rttvar = (3 * xbs->rttvar + delta) / 4;
+    xbs->srtt = (7 * xbs->srtt + rtt) / 8;
+  }
+
+  xbs->rto = xbs->srtt + 4 * xbs->rttvar;
+  if (xbs->rto < XBEE_MIN_RTO_MS * 1000L)
+    xbs->rto = XBEE_MIN_RTO_MS * 1000L;
+  if (xbs->rto > XBEE_MAX_RTO_MS * 1000L)
+    xbs->rto = XBEE_MAX_RTO_MS * 1000L;
+}
+
+struct XBeeWindowSlot {
+  const unsigned char *data;
+  unsigned char length;
+  unsigned char sequence;
+  unsigned char tries;
+  struct timeval sendTime;
+  struct timeval firstSendTime;
+};
+
+/*
+ * Windowed variant of xbeedev_send(): keep up to xbs->window chunks
+ * in flight, retire them in order as their ACKs arrive, and
+ * selectively retransmit only those chunks whose ACK is overdue.
+ */
+static int xbeedev_send_windowed(struct XBeeBootSession *xbs,
+                                 const unsigned char *buf, size_t buflen)
+{
+  struct XBeeWindowSlot slots[XBEE_MAX_WINDOW];
+  int head = 0, count = 0;
+  int rc = 0;
+  const long saved_timeout = serial_recv_timeout;
+
+  while (buflen > 0 || count > 0) {
+    /* Fill the window */
+    while (buflen > 0 && count < xbs->window) {
+      struct XBeeWindowSlot *slot = &slots[(head + count) % XBEE_MAX_WINDOW];
+      const unsigned char maximum_chunk = xbeedev_max_chunk(xbs);
+
+      unsigned char sequence = xbs->outSequence;
+      while ((++sequence & 0xff) == 0);
+      xbs->outSequence = sequence;
+
+      xbeedev_hint_receive(xbs);
+
+      slot->data = buf;
+      slot->length = (buflen > maximum_chunk) ? maximum_chunk : buflen;
+      slot->sequence = sequence;
+      slot->tries = 1;
+      xbs->acked[sequence] = 0;
+
+      rc = sendPacket(xbs, "Transmit Request Data [window], "
+                      "expect ACK for TRANSMIT",
+                      XBEEBOOT_PACKET_TYPE_REQUEST, sequence,
+                      XBEE_STATS_NOT_RETRY, XBEEBOOT_FIRMWARE_DELIVER,
+                      slot->length, slot->data);
+      if (rc < 0)
+        goto fail;
+
+      gettimeofday(&slot->sendTime, NULL);
+      slot->firstSendTime = slot->sendTime;
+
+      buf += slot->length;
+      buflen -= slot->length;
+      count++;
+    }
+
+    /* Retire ACK'd chunks from the head of the window, in order */
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    while (count > 0 && xbs->acked[slots[head].sequence]) {
+      if (slots[head].tries == 1)
+        xbeedev_update_rto(xbs,
+                           xbeedev_elapsed(&slots[head].sendTime, &now));
+      head = (head + 1) % XBEE_MAX_WINDOW;
+      count--;
+    }
+
+    if (count == 0)
+      continue;
+
+    /* Retransmit every unACK'd chunk whose timeout has expired */
+    long wait = xbs->rto;
+    int retransmitted = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+      struct XBeeWindowSlot *slot = &slots[(head + i) % XBEE_MAX_WINDOW];
+      if (xbs->acked[slot->sequence])
+        continue;
+
+      if (xbeedev_elapsed(&slot->firstSendTime, &now) >
+          XBEE_MAX_RETRIES * 1000000L) {
+        avrdude_message(MSG_INFO, "%s: xbeedev_send(): no ACK for "
+                        "sequence %d\n", progname, (int)slot->sequence);
+        rc = -1;
+        goto fail;
+      }
+
+      long remaining = xbs->rto - xbeedev_elapsed(&slot->sendTime, &now);
+      if (remaining <= 0) {
+        rc = sendPacket(xbs, "Transmit Request Data [window retry], "
+                        "expect ACK for TRANSMIT",
+                        XBEEBOOT_PACKET_TYPE_REQUEST, slot->sequence,
+                        XBEE_STATS_IS_RETRY, XBEEBOOT_FIRMWARE_DELIVER,
+                        slot->length, slot->data);
+        if (rc < 0)
+          goto fail;
+
+        gettimeofday(&slot->sendTime, NULL);
+        if (slot->tries < 255)
+          slot->tries++;
+        xbs->retransmissions++;
+        retransmitted = 1;
+        remaining = xbs->rto;
+      }
+
+      if (remaining < wait)
+        wait = remaining;
+    }
+
+    if (retransmitted) {
+      /* Back off, and probe the links as xbeedev_send() does */
+      xbs->rto *= 2;
+      if (xbs->rto > XBEE_MAX_RTO_MS * 1000L)
+        xbs->rto = XBEE_MAX_RTO_MS * 1000L;
+
+      localAsyncAT(xbs, "Local XBee ping [send]", 'A', 'P', -1);
+
+      if (xbs->inSequence != 0) {
+        rc = sendPacket(xbs,
+                        "Transmit Request ACK [Retry in send] "
+                        "for RECEIVE",
+                        XBEEBOOT_PACKET_TYPE_ACK,
+                        xbs->inSequence,
+                        XBEE_STATS_IS_RETRY,
+                        -1, 0, NULL);
+        if (rc < 0)
+          goto fail;
+      }
+    }
+
+    /*
+     * Wait for the next ACK, but no longer than the earliest
+     * retransmission deadline.  A timeout is not an error here.
+     */
+    serial_recv_timeout = wait / 1000 + 1;
+    (void) xbeedev_poll(xbs, NULL, NULL, XBEE_ANY_ACK, -1);
+    serial_recv_timeout = saved_timeout;
+  }
+
+  return 0;
+
+ fail:
+  serial_recv_timeout = saved_timeout;
+  /* There is no way to recover from a failure mid-send */
+  xbs->transportUnusable = 1;
+  return rc;
+}
+
 static int xbeedev_send(const union filedescriptor *fdp,
                         const unsigned char *buf, size_t buflen)
 {
@@ -1316,53 +1656,17 @@ static int xbeedev_send(const union filedescriptor *fdp,
     /* Don't attempt to continue on an unusable transport layer */
     return -1;
 
+  if (xbs->window > 1)
+    return xbeedev_send_windowed(xbs, buf, buflen);
+
   while (buflen > 0) {
     unsigned char sequence = xbs->outSequence;
     while ((++sequence & 0xff) == 0);
     xbs->outSequence = sequence;
 
-    /*
-     * We are about to send some data, and that might lead potentially
-     * to received data before we see the ACK for this transmission.
-     * As this might be the trigger seen before the next "recv"
-     * operation, record that we have delivered this potential
-     * trigger.
-     */
-    {
-      unsigned char nextSequence = xbs->inSequence;
-      while ((++nextSequence & 0xff) == 0);
-
-      struct timeval sendTime;
-      gettimeofday(&sendTime, NULL);
-
-      /*
-       * Optimistic records should never be treated as retries,
-       * because they might simply be guessing too optimistically.
-       */
-      xbeedev_stats_send(xbs, "send() hints possible triggered RECEIVE",
-                         nextSequence,
-                         XBEE_STATS_RECEIVE,
-                         nextSequence, 0, &sendTime);
-    }
-
-    /*
-     * Chunk the data into chunks of up to XBEEBOOT_MAX_CHUNK bytes.
-     */
-    unsigned char maximum_chunk = XBEEBOOT_MAX_CHUNK;
-
-    /*
-     * Source routing incurs a two byte fixed overhead, plus a two
-     * byte additional cost per intermediate hop.
-     *
-     * We are attempting to avoid fragmentation here, so resize our
-     * maximum size to anticipate the overhead of the current number
-     * of hops.  If our maximum chunk would be less than one, just
-     * give up and hope fragmentation will somehow save us.
-     */
-    const int hops = xbs->sourceRouteHops;
-    if (hops > 0 && (hops * 2 + 2) < XBEEBOOT_MAX_CHUNK)
-      maximum_chunk -= hops * 2 + 2;
+    xbeedev_hint_receive(xbs);
 
+    const unsigned char maximum_chunk = xbeedev_max_chunk(xbs);
     const unsigned char blockLength =
       (buflen > maximum_chunk) ? maximum_chunk : buflen;
 
@@ -1376,7 +1680,7 @@ static int xbeedev_send(const union filedescriptor *fdp,
                    "Transmit Request Data, expect ACK for TRANSMIT",
                    XBEEBOOT_PACKET_TYPE_REQUEST, sequence,
                    retries > 0 ? XBEE_STATS_IS_RETRY : XBEE_STATS_NOT_RETRY,
-                   23 /* FIRMWARE_DELIVER */,
+                   XBEEBOOT_FIRMWARE_DELIVER,
                    blockLength, buf);
       if (sendRc < 0) {
         /* There is no way to recover from a failure mid-send */
@@ -1649,6 +1953,9 @@ static int xbee_open(PROGRAMMER *pgm, const char *port) {
   if (xbee_getsync(pgm) < 0)
     return -1;
 
+  if (xbeedev_setwindow(&pgm->fd, PDATA(pgm)->xbeeWindow) < 0)
+    return -1;
+
   return 0;
 }
 
@@ -1688,6 +1995,12 @@ static void xbee_close(PROGRAMMER *pgm)
   avrdude_message(MSG_NOTICE, "%s: Statistics for RECEIVE requests - XBeeBoot->XBee(target)->XBee(local)->%s\n", progname, progname);
   xbeeStatsSummarise(&xbs->groupSummary[XBEE_STATS_RECEIVE]);
 
+  if (xbs->window > 1)
+    avrdude_message(MSG_NOTICE, "%s: Transmit window %d chunks, "
+                    "%lu retransmissions, final RTO %ld ms\n",
+                    progname, xbs->window, xbs->retransmissions,
+                    xbs->rto / 1000);
+
   xbeedev_free(xbs);
 
   pgm->fd.pfd = NULL;
@@ -1717,6 +2030,22 @@ static int xbee_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
       continue;
     }
 
+    if (strncmp(extended_param,
+                "xbeewindow=", 11 /*strlen("xbeewindow=")*/) == 0) {
+      int window;
+      if (sscanf(extended_param, "xbeewindow=%i", &window) != 1 ||
+          window <= 0 || window > XBEE_MAX_WINDOW) {
+        avrdude_message(MSG_INFO, "%s: xbee_parseextparms(): "
+                        "invalid xbeewindow '%s'\n",
+                        progname, extended_param);
+        rc = -1;
+        continue;
+      }
+
+      PDATA(pgm)->xbeeWindow = window;
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: xbee_parseextparms(): "
                     "invalid extended parameter '%s'\n",
                     progname, extended_param);